@@ -0,0 +1,481 @@
+#include "AabbTree.h"
+
+#include <algorithm>
+#include <cfloat>
+
+static float SurfaceArea(const vec3& min, const vec3& max)
+{
+	vec3 d = max - min;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static bool Contains(const AabbTree::Node& node, const vec3& min, const vec3& max)
+{
+	return all(lessThanEqual(node.Min, min)) && all(greaterThanEqual(node.Max, max));
+}
+
+void AabbTree::Clear()
+{
+	nodes.clear();
+	root = Null;
+	freeList = Null;
+}
+
+int AabbTree::AllocateNode()
+{
+	int node;
+
+	if (freeList != Null)
+	{
+		node = freeList;
+		freeList = nodes[node].Parent;
+		nodes[node] = Node();
+	}
+	else
+	{
+		node = (int)nodes.size();
+		nodes.push_back(Node());
+	}
+
+	nodes[node].Height = 0;
+
+	return node;
+}
+
+void AabbTree::FreeNode(int node)
+{
+	nodes[node].Height = -1;
+	nodes[node].Parent = freeList;
+	freeList = node;
+}
+
+void AabbTree::Build(const std::vector<BuildLeaf>& leaves, std::vector<int>& proxies)
+{
+	Clear();
+
+	proxies.assign(leaves.size(), Null);
+
+	if (leaves.empty())
+		return;
+
+	nodes.reserve(leaves.size() * 2);
+
+	std::vector<int> order(leaves.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = (int)i;
+
+	root = BuildRange(order, 0, (int)order.size(), leaves, proxies);
+	nodes[root].Parent = Null;
+}
+
+int AabbTree::BuildRange(std::vector<int>& order, int begin, int end, const std::vector<BuildLeaf>& leaves, std::vector<int>& proxies)
+{
+	if (end - begin == 1)
+	{
+		const BuildLeaf& leaf = leaves[order[begin]];
+
+		int node = AllocateNode();
+		nodes[node].Min = leaf.Min;
+		nodes[node].Max = leaf.Max;
+		nodes[node].UserData = leaf.UserData;
+
+		proxies[order[begin]] = node;
+
+		return node;
+	}
+
+	// split at the median centroid along the widest axis of the centroids
+	vec3 centerMin = vec3(FLT_MAX);
+	vec3 centerMax = vec3(-FLT_MAX);
+
+	for (int i = begin; i < end; i++)
+	{
+		vec3 center = (leaves[order[i]].Min + leaves[order[i]].Max) * 0.5f;
+		centerMin = min(centerMin, center);
+		centerMax = max(centerMax, center);
+	}
+
+	vec3 extent = centerMax - centerMin;
+
+	int axis = 0;
+	if (extent.y > extent[axis]) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+
+	int middle = (begin + end) / 2;
+
+	std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+		[&leaves, axis](int a, int b) {
+			return leaves[a].Min[axis] + leaves[a].Max[axis] < leaves[b].Min[axis] + leaves[b].Max[axis];
+		});
+
+	int child1 = BuildRange(order, begin, middle, leaves, proxies);
+	int child2 = BuildRange(order, middle, end, leaves, proxies);
+
+	int node = AllocateNode();
+
+	nodes[node].Child1 = child1;
+	nodes[node].Child2 = child2;
+	nodes[node].Min = min(nodes[child1].Min, nodes[child2].Min);
+	nodes[node].Max = max(nodes[child1].Max, nodes[child2].Max);
+	nodes[node].Height = 1 + std::max(nodes[child1].Height, nodes[child2].Height);
+
+	nodes[child1].Parent = node;
+	nodes[child2].Parent = node;
+
+	return node;
+}
+
+int AabbTree::Insert(const vec3& min, const vec3& max, uint32_t userData)
+{
+	int leaf = AllocateNode();
+
+	nodes[leaf].Min = min - vec3(Margin);
+	nodes[leaf].Max = max + vec3(Margin);
+	nodes[leaf].UserData = userData;
+
+	InsertLeaf(leaf);
+
+	return leaf;
+}
+
+void AabbTree::Remove(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+}
+
+bool AabbTree::Move(int proxy, const vec3& min, const vec3& max)
+{
+	if (Contains(nodes[proxy], min, max))
+		return false;
+
+	RemoveLeaf(proxy);
+
+	nodes[proxy].Min = min - vec3(Margin);
+	nodes[proxy].Max = max + vec3(Margin);
+
+	InsertLeaf(proxy);
+
+	return true;
+}
+
+void AabbTree::InsertLeaf(int leaf)
+{
+	if (root == Null)
+	{
+		root = leaf;
+		nodes[root].Parent = Null;
+		return;
+	}
+
+	vec3 leafMin = nodes[leaf].Min;
+	vec3 leafMax = nodes[leaf].Max;
+
+	// walk down picking the child whose box grows the least (surface area heuristic)
+	int index = root;
+	while (nodes[index].IsLeaf() == false)
+	{
+		const Node& node = nodes[index];
+
+		float area = SurfaceArea(node.Min, node.Max);
+		float combinedArea = SurfaceArea(min(node.Min, leafMin), max(node.Max, leafMax));
+
+		// cost of making a new parent for this node and the leaf
+		float cost = 2.0f * combinedArea;
+
+		// minimum cost of pushing the leaf further down
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		int children[2] = { node.Child1, node.Child2 };
+
+		for (int i = 0; i < 2; i++)
+		{
+			const Node& child = nodes[children[i]];
+
+			float unionArea = SurfaceArea(min(child.Min, leafMin), max(child.Max, leafMax));
+
+			if (child.IsLeaf())
+				childCost[i] = unionArea + inheritanceCost;
+			else
+				childCost[i] = unionArea - SurfaceArea(child.Min, child.Max) + inheritanceCost;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	int sibling = index;
+
+	int oldParent = nodes[sibling].Parent;
+	int newParent = AllocateNode();
+
+	nodes[newParent].Parent = oldParent;
+	nodes[newParent].Min = min(leafMin, nodes[sibling].Min);
+	nodes[newParent].Max = max(leafMax, nodes[sibling].Max);
+	nodes[newParent].Height = nodes[sibling].Height + 1;
+	nodes[newParent].Child1 = sibling;
+	nodes[newParent].Child2 = leaf;
+
+	if (oldParent != Null)
+	{
+		if (nodes[oldParent].Child1 == sibling)
+			nodes[oldParent].Child1 = newParent;
+		else
+			nodes[oldParent].Child2 = newParent;
+	}
+	else
+	{
+		root = newParent;
+	}
+
+	nodes[sibling].Parent = newParent;
+	nodes[leaf].Parent = newParent;
+
+	// refit and rebalance the ancestors
+	index = nodes[leaf].Parent;
+	while (index != Null)
+	{
+		index = Balance(index);
+
+		int child1 = nodes[index].Child1;
+		int child2 = nodes[index].Child2;
+
+		nodes[index].Height = 1 + std::max(nodes[child1].Height, nodes[child2].Height);
+		nodes[index].Min = min(nodes[child1].Min, nodes[child2].Min);
+		nodes[index].Max = max(nodes[child1].Max, nodes[child2].Max);
+
+		index = nodes[index].Parent;
+	}
+}
+
+void AabbTree::RemoveLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = Null;
+		return;
+	}
+
+	int parent = nodes[leaf].Parent;
+	int grandParent = nodes[parent].Parent;
+	int sibling = nodes[parent].Child1 == leaf ? nodes[parent].Child2 : nodes[parent].Child1;
+
+	if (grandParent == Null)
+	{
+		root = sibling;
+		nodes[sibling].Parent = Null;
+		FreeNode(parent);
+		return;
+	}
+
+	// the sibling takes the parent's place
+	if (nodes[grandParent].Child1 == parent)
+		nodes[grandParent].Child1 = sibling;
+	else
+		nodes[grandParent].Child2 = sibling;
+
+	nodes[sibling].Parent = grandParent;
+	FreeNode(parent);
+
+	int index = grandParent;
+	while (index != Null)
+	{
+		index = Balance(index);
+
+		int child1 = nodes[index].Child1;
+		int child2 = nodes[index].Child2;
+
+		nodes[index].Min = min(nodes[child1].Min, nodes[child2].Min);
+		nodes[index].Max = max(nodes[child1].Max, nodes[child2].Max);
+		nodes[index].Height = 1 + std::max(nodes[child1].Height, nodes[child2].Height);
+
+		index = nodes[index].Parent;
+	}
+}
+
+// Rotates the taller grandchild up if node's subtrees differ in height by more than one.
+// Returns the node now at this position.
+int AabbTree::Balance(int iA)
+{
+	Node& A = nodes[iA];
+
+	if (A.IsLeaf() || A.Height < 2)
+		return iA;
+
+	int iB = A.Child1;
+	int iC = A.Child2;
+
+	Node& B = nodes[iB];
+	Node& C = nodes[iC];
+
+	int balance = C.Height - B.Height;
+
+	// rotate C up
+	if (balance > 1)
+	{
+		int iF = C.Child1;
+		int iG = C.Child2;
+
+		Node& F = nodes[iF];
+		Node& G = nodes[iG];
+
+		C.Child1 = iA;
+		C.Parent = A.Parent;
+		A.Parent = iC;
+
+		if (C.Parent != Null)
+		{
+			if (nodes[C.Parent].Child1 == iA)
+				nodes[C.Parent].Child1 = iC;
+			else
+				nodes[C.Parent].Child2 = iC;
+		}
+		else
+		{
+			root = iC;
+		}
+
+		if (F.Height > G.Height)
+		{
+			C.Child2 = iF;
+			A.Child2 = iG;
+			G.Parent = iA;
+
+			A.Min = min(B.Min, G.Min);
+			A.Max = max(B.Max, G.Max);
+			C.Min = min(A.Min, F.Min);
+			C.Max = max(A.Max, F.Max);
+
+			A.Height = 1 + std::max(B.Height, G.Height);
+			C.Height = 1 + std::max(A.Height, F.Height);
+		}
+		else
+		{
+			C.Child2 = iG;
+			A.Child2 = iF;
+			F.Parent = iA;
+
+			A.Min = min(B.Min, F.Min);
+			A.Max = max(B.Max, F.Max);
+			C.Min = min(A.Min, G.Min);
+			C.Max = max(A.Max, G.Max);
+
+			A.Height = 1 + std::max(B.Height, F.Height);
+			C.Height = 1 + std::max(A.Height, G.Height);
+		}
+
+		return iC;
+	}
+
+	// rotate B up
+	if (balance < -1)
+	{
+		int iD = B.Child1;
+		int iE = B.Child2;
+
+		Node& D = nodes[iD];
+		Node& E = nodes[iE];
+
+		B.Child1 = iA;
+		B.Parent = A.Parent;
+		A.Parent = iB;
+
+		if (B.Parent != Null)
+		{
+			if (nodes[B.Parent].Child1 == iA)
+				nodes[B.Parent].Child1 = iB;
+			else
+				nodes[B.Parent].Child2 = iB;
+		}
+		else
+		{
+			root = iB;
+		}
+
+		if (D.Height > E.Height)
+		{
+			B.Child2 = iD;
+			A.Child1 = iE;
+			E.Parent = iA;
+
+			A.Min = min(C.Min, E.Min);
+			A.Max = max(C.Max, E.Max);
+			B.Min = min(A.Min, D.Min);
+			B.Max = max(A.Max, D.Max);
+
+			A.Height = 1 + std::max(C.Height, E.Height);
+			B.Height = 1 + std::max(A.Height, D.Height);
+		}
+		else
+		{
+			B.Child2 = iE;
+			A.Child1 = iD;
+			D.Parent = iA;
+
+			A.Min = min(C.Min, D.Min);
+			A.Max = max(C.Max, D.Max);
+			B.Min = min(A.Min, E.Min);
+			B.Max = max(A.Max, E.Max);
+
+			A.Height = 1 + std::max(C.Height, D.Height);
+			B.Height = 1 + std::max(A.Height, E.Height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+void AabbTree::CollectLeaves(int node, std::vector<uint32_t>& output) const
+{
+	if (nodes[node].IsLeaf())
+	{
+		output.push_back(nodes[node].UserData);
+		return;
+	}
+
+	CollectLeaves(nodes[node].Child1, output);
+	CollectLeaves(nodes[node].Child2, output);
+}
+
+void AabbTree::Query(const Frustum& frustum, std::vector<uint32_t>& inside, std::vector<uint32_t>& partial) const
+{
+	if (root == Null)
+		return;
+
+	stack.clear();
+	stack.push_back(root);
+
+	while (stack.empty() == false)
+	{
+		int index = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[index];
+
+		Frustum::BoxResult result = frustum.ClassifyBox(node.Min, node.Max);
+
+		if (result == Frustum::BoxOutside)
+			continue;
+
+		if (result == Frustum::BoxInside)
+		{
+			CollectLeaves(index, inside);
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			partial.push_back(node.UserData);
+		}
+		else
+		{
+			stack.push_back(node.Child1);
+			stack.push_back(node.Child2);
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm.h"
+
+#include "FrustrumCull.hpp"
+
+// Bounding volume hierarchy over axis aligned boxes. Leaves carry a 32-bit user value.
+//
+// Build() creates a balanced tree top-down in one go (used for static geometry at load).
+// Insert/Remove/Move update it incrementally: inserted leaves are enlarged by Margin so
+// small movements do not touch the tree, and the tree is rebalanced with rotations on the
+// way up like the usual dynamic AABB tree.
+class AabbTree
+{
+public:
+
+	static constexpr int Null = -1;
+
+	struct Node
+	{
+		vec3 Min = vec3(0);
+		vec3 Max = vec3(0);
+
+		int Parent = Null;
+		int Child1 = Null;
+		int Child2 = Null;
+
+		// leaf = 0, free node = -1
+		int Height = -1;
+
+		uint32_t UserData = 0;
+
+		bool IsLeaf() const { return Child1 == Null; }
+	};
+
+	struct BuildLeaf
+	{
+		vec3 Min;
+		vec3 Max;
+		uint32_t UserData;
+	};
+
+	// how much inserted leaves are enlarged in every direction
+	float Margin = 0.2f;
+
+	// Replaces the tree with one built from the given leaves. proxies[i] receives the node of leaves[i].
+	void Build(const std::vector<BuildLeaf>& leaves, std::vector<int>& proxies);
+
+	void Clear();
+
+	int Insert(const vec3& min, const vec3& max, uint32_t userData);
+	void Remove(int proxy);
+
+	// Refits a leaf. Returns true if it had to be reinserted.
+	bool Move(int proxy, const vec3& min, const vec3& max);
+
+	void SetUserData(int proxy, uint32_t userData) { nodes[proxy].UserData = userData; }
+	uint32_t GetUserData(int proxy) const { return nodes[proxy].UserData; }
+
+	bool IsEmpty() const { return root == Null; }
+	int GetHeight() const { return root == Null ? 0 : nodes[root].Height; }
+
+	// Leaves in subtrees fully inside the frustum go to inside, leaves whose own box only
+	// intersects it go to partial for a finer test by the caller.
+	void Query(const Frustum& frustum, std::vector<uint32_t>& inside, std::vector<uint32_t>& partial) const;
+
+private:
+
+	std::vector<Node> nodes;
+	int root = Null;
+	int freeList = Null;
+
+	// scratch used by Query, kept to avoid allocating every frame
+	mutable std::vector<int> stack;
+
+	int AllocateNode();
+	void FreeNode(int node);
+
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+
+	int Balance(int node);
+
+	void CollectLeaves(int node, std::vector<uint32_t>& output) const;
+
+	int BuildRange(std::vector<int>& order, int begin, int end, const std::vector<BuildLeaf>& leaves, std::vector<int>& proxies);
+
+};
@@ -57,8 +57,8 @@ public:
         std::string filePath = "GameData/Shaders/" + fileName;
         std::string shaderCode = ReadFileToString(filePath);
 
-        // Cache the newly loaded shader
-        shaderCache[key] = Shader::FromCode(shaderCode.c_str(), shaderType);
+        // Cache the newly loaded shader, it compiles when a program first uses it
+        shaderCache[key] = Shader::FromCode(shaderCode.c_str(), shaderType, false);
 
         return shaderCache[key];
     }
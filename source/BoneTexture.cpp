@@ -0,0 +1,61 @@
+#include "BoneTexture.h"
+
+#include "RenderPacket.h"
+#include "RenderState.h"
+
+GLuint BoneTexture::texture = 0;
+int BoneTexture::height = 0;
+
+void BoneTexture::Init()
+{
+	glGenTextures(1, &texture);
+
+	Resize(16);
+}
+
+void BoneTexture::Resize(int rows)
+{
+	height = rows;
+
+	RenderState::BindTexture(TextureUnit, GL_TEXTURE_2D, texture);
+
+	// float textures are not filterable everywhere, texelFetch does not need it anyway
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, Width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+
+	RenderState::ActiveTexture(0);
+}
+
+void BoneTexture::Upload(const RenderPacket& packet)
+{
+	int texels = (int)packet.BonePalette.size() * 4;
+	int rows = (texels + Width - 1) / Width;
+
+	if (rows > height)
+	{
+		int newHeight = height;
+		while (newHeight < rows)
+			newHeight *= 2;
+
+		Resize(newHeight);
+	}
+
+	RenderState::BindTexture(TextureUnit, GL_TEXTURE_2D, texture);
+
+	const float* data = (const float*)packet.BonePalette.data();
+
+	int fullRows = texels / Width;
+	if (fullRows > 0)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Width, fullRows, GL_RGBA, GL_FLOAT, data);
+
+	int remainder = texels - fullRows * Width;
+	if (remainder > 0)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, fullRows, remainder, 1, GL_RGBA, GL_FLOAT, data + fullRows * Width * 4);
+
+	// the texture stays bound to its own unit for the whole frame
+	RenderState::ActiveTexture(0);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include "gl.h"
+#include "glm.h"
+
+struct RenderPacket;
+
+// Bone matrices of every skinned draw in a packet, uploaded once per frame into an
+// RGBA32F texture. A matrix takes 4 consecutive texels (its columns), Width texels per
+// row, so it never straddles rows.
+//
+// Draws find their matrices through ObjectData.objectFlags (y: first bone, z: bone count,
+// see UniformBuffers.h) and the shader reads them with texelFetch from the bonePalette
+// sampler, which ShaderProgram points at TextureUnit when linking.
+class BoneTexture
+{
+public:
+
+	static const int Width = 1024;
+
+	// kept out of the units ShaderProgram::SetTexture hands out
+	static const GLuint TextureUnit = 15;
+
+	static void Init();
+
+	// Uploads packet.BonePalette and binds the texture.
+	static void Upload(const RenderPacket& packet);
+
+private:
+
+	static GLuint texture;
+	static int height;
+
+	static void Resize(int rows);
+
+};
@@ -0,0 +1,302 @@
+#include "BoundsTable.h"
+
+#include <cfloat>
+
+#include "IDrawMesh.h"
+#include "JobScheduler.h"
+#include "SimdMath.hpp"
+#include "Profiler.h"
+
+// Box used for unbounded rows. Finite so tree surface areas stay finite.
+static const float UnboundedExtent = 1.0e9f;
+
+BoundsTable::~BoundsTable()
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Meshes[i]->BoundsRow = -1;
+		Meshes[i]->boundsTable = nullptr;
+	}
+}
+
+void BoundsTable::Reserve(uint32_t rows)
+{
+	uint32_t padded = (rows + 3) & ~3u;
+
+	if (Meshes.size() >= padded)
+		return;
+
+	Meshes.resize(padded, nullptr);
+	Owners.resize(padded, nullptr);
+
+	CenterX.resize(padded);
+	CenterY.resize(padded);
+	CenterZ.resize(padded);
+	Radius.resize(padded);
+
+	MinX.resize(padded);
+	MinY.resize(padded);
+	MinZ.resize(padded);
+	MaxX.resize(padded);
+	MaxY.resize(padded);
+	MaxZ.resize(padded);
+
+	Proxies.resize(padded, AabbTree::Null);
+	Moved.resize(padded);
+}
+
+void BoundsTable::Add(IDrawMesh* mesh, LevelObject* owner)
+{
+	if (mesh->boundsTable != nullptr)
+		return;
+
+	Reserve(count + 1);
+
+	uint32_t row = count++;
+	revision++;
+
+	Meshes[row] = mesh;
+	Owners[row] = owner;
+	Moved[row] = 0;
+	Proxies[row] = AabbTree::Null;
+
+	mesh->BoundsRow = (int)row;
+	mesh->boundsTable = this;
+	mesh->BoundsDirty = true;
+
+	mesh->UpdateBounds(*this, row);
+
+	if (isStatic)
+	{
+		rebuildTree = true;
+	}
+	else
+	{
+		Proxies[row] = tree.Insert(vec3(MinX[row], MinY[row], MinZ[row]), vec3(MaxX[row], MaxY[row], MaxZ[row]), row);
+	}
+}
+
+void BoundsTable::Remove(IDrawMesh* mesh)
+{
+	if (mesh->boundsTable != this)
+		return;
+
+	uint32_t row = (uint32_t)mesh->BoundsRow;
+	uint32_t last = --count;
+	revision++;
+
+	if (Proxies[row] != AabbTree::Null)
+		tree.Remove(Proxies[row]);
+
+	if (row != last)
+	{
+		Meshes[row] = Meshes[last];
+		Owners[row] = Owners[last];
+
+		CenterX[row] = CenterX[last];
+		CenterY[row] = CenterY[last];
+		CenterZ[row] = CenterZ[last];
+		Radius[row] = Radius[last];
+
+		MinX[row] = MinX[last];
+		MinY[row] = MinY[last];
+		MinZ[row] = MinZ[last];
+		MaxX[row] = MaxX[last];
+		MaxY[row] = MaxY[last];
+		MaxZ[row] = MaxZ[last];
+
+		Proxies[row] = Proxies[last];
+		Moved[row] = Moved[last];
+
+		Meshes[row]->BoundsRow = (int)row;
+
+		if (Proxies[row] != AabbTree::Null)
+			tree.SetUserData(Proxies[row], row);
+	}
+
+	Meshes[last] = nullptr;
+	Owners[last] = nullptr;
+	Proxies[last] = AabbTree::Null;
+
+	mesh->BoundsRow = -1;
+	mesh->boundsTable = nullptr;
+}
+
+void BoundsTable::SetBounds(uint32_t row, const WorldBounds& bounds)
+{
+	CenterX[row] = bounds.Center.x;
+	CenterY[row] = bounds.Center.y;
+	CenterZ[row] = bounds.Center.z;
+	Radius[row] = bounds.Radius;
+
+	MinX[row] = bounds.Min.x;
+	MinY[row] = bounds.Min.y;
+	MinZ[row] = bounds.Min.z;
+	MaxX[row] = bounds.Max.x;
+	MaxY[row] = bounds.Max.y;
+	MaxZ[row] = bounds.Max.z;
+}
+
+void BoundsTable::SetUnbounded(uint32_t row)
+{
+	WorldBounds bounds;
+	bounds.Min = vec3(-UnboundedExtent);
+	bounds.Max = vec3(UnboundedExtent);
+	bounds.Radius = FLT_MAX;
+
+	SetBounds(row, bounds);
+}
+
+void BoundsTable::RefreshRows()
+{
+	// 256 rows per job, small enough to balance, big enough to amortize dispatch
+	JobScheduler::ParallelFor(count, 256, [this](uint32_t start, uint32_t end)
+		{
+			for (uint32_t row = start; row < end; row++)
+			{
+				Moved[row] = Meshes[row]->UpdateBounds(*this, row) ? 1 : 0;
+			}
+		});
+
+	// tree updates are serial, but only leaves that left their enlarged box touch it
+	for (uint32_t row = 0; row < count; row++)
+	{
+		if (Moved[row] == 0)
+			continue;
+
+		tree.Move(Proxies[row], vec3(MinX[row], MinY[row], MinZ[row]), vec3(MaxX[row], MaxY[row], MaxZ[row]));
+	}
+}
+
+void BoundsTable::RebuildTree()
+{
+	rebuildTree = false;
+
+	std::vector<AabbTree::BuildLeaf> leaves(count);
+
+	for (uint32_t row = 0; row < count; row++)
+	{
+		leaves[row].Min = vec3(MinX[row], MinY[row], MinZ[row]);
+		leaves[row].Max = vec3(MaxX[row], MaxY[row], MaxZ[row]);
+		leaves[row].UserData = row;
+	}
+
+	std::vector<int> proxies;
+	tree.Build(leaves, proxies);
+
+	for (uint32_t row = 0; row < count; row++)
+	{
+		Proxies[row] = proxies[row];
+	}
+}
+
+void BoundsTable::TestPartialRows(const Frustum& frustum, std::vector<uint32_t>& rows)
+{
+	uint32_t partialCount = (uint32_t)partialRows.size();
+	if (partialCount == 0)
+		return;
+
+	partialVisible.resize(partialCount);
+
+	const vec4* planes = frustum.GetPlanes();
+
+	uint32_t blocks = (partialCount + 3) / 4;
+
+	JobScheduler::ParallelFor(blocks, 64, [this, planes, partialCount](uint32_t startBlock, uint32_t endBlock)
+		{
+			simd::float4 planeX[6], planeY[6], planeZ[6], planeW[6];
+
+			for (int p = 0; p < 6; p++)
+			{
+				planeX[p] = simd::Splat(planes[p].x);
+				planeY[p] = simd::Splat(planes[p].y);
+				planeZ[p] = simd::Splat(planes[p].z);
+				planeW[p] = simd::Splat(planes[p].w);
+			}
+
+			for (uint32_t block = startBlock; block < endBlock; block++)
+			{
+				uint32_t base = block * 4;
+				uint32_t lanes = std::min(4u, partialCount - base);
+
+				// gather the spheres of up to 4 rows, unused lanes repeat the first one
+				float x[4], y[4], z[4], radius[4];
+
+				for (uint32_t lane = 0; lane < 4; lane++)
+				{
+					uint32_t row = partialRows[base + (lane < lanes ? lane : 0)];
+
+					x[lane] = CenterX[row];
+					y[lane] = CenterY[row];
+					z[lane] = CenterZ[row];
+					radius[lane] = Radius[row];
+				}
+
+				simd::float4 cx = simd::Load(x);
+				simd::float4 cy = simd::Load(y);
+				simd::float4 cz = simd::Load(z);
+				simd::float4 negRadius = simd::Neg(simd::Load(radius));
+
+				simd::float4 outside = simd::Splat(0);
+
+				// outside if the signed distance to any plane is below -radius
+				for (int p = 0; p < 6; p++)
+				{
+					simd::float4 distance = simd::MulAdd(cx, planeX[p], simd::MulAdd(cy, planeY[p], simd::MulAdd(cz, planeZ[p], planeW[p])));
+					outside = simd::Or(outside, simd::Less(distance, negRadius));
+				}
+
+				int mask = simd::MoveMask(outside);
+
+				for (uint32_t lane = 0; lane < lanes; lane++)
+				{
+					partialVisible[base + lane] = ((mask >> lane) & 1) == 0;
+				}
+			}
+		});
+
+	for (uint32_t i = 0; i < partialCount; i++)
+	{
+		if (partialVisible[i])
+			rows.push_back(partialRows[i]);
+	}
+}
+
+void BoundsTable::RefreshAndCull(const Frustum& frustum)
+{
+	PROFILE_SCOPE("RefreshAndCull");
+
+	VisibleRows.clear();
+	partialRows.clear();
+
+	if (count == 0)
+		return;
+
+	if (isStatic == false)
+		RefreshRows();
+
+	if (rebuildTree)
+		RebuildTree();
+
+	tree.Query(frustum, VisibleRows, partialRows);
+
+	TestPartialRows(frustum, VisibleRows);
+}
+
+void BoundsTable::Cull(const Frustum& frustum, std::vector<uint32_t>& rows)
+{
+	PROFILE_SCOPE("Cull");
+
+	rows.clear();
+	partialRows.clear();
+
+	if (count == 0)
+		return;
+
+	if (rebuildTree)
+		RebuildTree();
+
+	tree.Query(frustum, rows, partialRows);
+
+	TestPartialRows(frustum, rows);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm.h"
+
+#include "FrustrumCull.hpp"
+#include "AabbTree.h"
+
+class IDrawMesh;
+class LevelObject;
+
+struct WorldBounds
+{
+	vec3 Min = vec3(0);
+	vec3 Max = vec3(0);
+
+	vec3 Center = vec3(0);
+	float Radius = 0;
+};
+
+// World-space bounds of a set of drawables, stored as a structure of arrays so partially
+// visible rows can be tested 4 at a time. Rows are kept dense with swap-remove, each mesh
+// remembers its row in IDrawMesh::BoundsRow. An AabbTree over the rows rejects and accepts
+// whole groups before any per-row test.
+//
+// Static tables never refresh their rows and build the tree top-down when rows were added.
+// Dynamic tables let every mesh refresh its row each frame and refit the tree incrementally.
+class BoundsTable
+{
+public:
+
+	std::vector<IDrawMesh*> Meshes;
+	std::vector<LevelObject*> Owners;
+
+	// bounding spheres
+	std::vector<float> CenterX;
+	std::vector<float> CenterY;
+	std::vector<float> CenterZ;
+	std::vector<float> Radius;
+
+	// axis aligned boxes
+	std::vector<float> MinX;
+	std::vector<float> MinY;
+	std::vector<float> MinZ;
+	std::vector<float> MaxX;
+	std::vector<float> MaxY;
+	std::vector<float> MaxZ;
+
+	// tree leaf of each row
+	std::vector<int> Proxies;
+
+	// set by the refresh pass for rows whose bounds changed this frame
+	std::vector<uint8_t> Moved;
+
+	// rows that passed the last RefreshAndCull, in no particular order
+	std::vector<uint32_t> VisibleRows;
+
+	explicit BoundsTable(bool isStatic) : isStatic(isStatic) {}
+	~BoundsTable();
+
+	BoundsTable(const BoundsTable&) = delete;
+	BoundsTable& operator=(const BoundsTable&) = delete;
+
+	uint32_t Count() const { return count; }
+
+	// changes whenever a row is added or removed
+	uint32_t GetRevision() const { return revision; }
+	bool IsStatic() const { return isStatic; }
+
+	void Add(IDrawMesh* mesh, LevelObject* owner);
+	void Remove(IDrawMesh* mesh);
+
+	void SetBounds(uint32_t row, const WorldBounds& bounds);
+
+	// For meshes without bounds. The row always passes culling.
+	void SetUnbounded(uint32_t row);
+
+	// Refreshes dynamic rows, walks the tree and tests the rows of partially visible leaves
+	// against the frustum. Fills VisibleRows.
+	void RefreshAndCull(const Frustum& frustum);
+
+	// Culls the rows as of the last refresh against another frustum (a light's) into rows.
+	// Leaves VisibleRows alone.
+	void Cull(const Frustum& frustum, std::vector<uint32_t>& rows);
+
+private:
+
+	bool isStatic = false;
+
+	uint32_t count = 0;
+	uint32_t revision = 0;
+
+	AabbTree tree;
+	bool rebuildTree = false;
+
+	std::vector<uint32_t> partialRows;
+	std::vector<uint8_t> partialVisible;
+
+	// arrays are sized to count rounded up to 4
+	void Reserve(uint32_t rows);
+
+	void RefreshRows();
+	void RebuildTree();
+	void TestPartialRows(const Frustum& frustum, std::vector<uint32_t>& rows);
+
+};
@@ -4,6 +4,7 @@
 
 #include <vector>
 #include <string>
+#include <cfloat>
 
 #include "model.hpp"
 
@@ -17,6 +18,14 @@ class BrushFaceMesh : public StaticMesh
 {
 private:
 
+	// local box of vertexLocations, computed on first use
+	bool hasLocalBounds = false;
+	vec3 localMin = vec3(0);
+	vec3 localMax = vec3(0);
+
+	// world space triangles of the faces, built on first use
+	bool hasOccluderTriangles = false;
+	vector<vec3> occluderTriangles;
 
 public:
 
@@ -42,6 +51,86 @@ public:
 		delete(model);
 	}
 
+	// The model's sphere is shared by every face of a brush, so use a box around this face's vertices instead.
+	bool GetWorldBounds(WorldBounds& bounds)
+	{
+		if (vertexLocations.empty())
+			return StaticMesh::GetWorldBounds(bounds);
+
+		if (hasLocalBounds == false)
+		{
+			localMin = vertexLocations[0];
+			localMax = vertexLocations[0];
+
+			for (const vec3& location : vertexLocations)
+			{
+				localMin = min(localMin, location);
+				localMax = max(localMax, location);
+			}
+
+			hasLocalBounds = true;
+		}
+
+		mat4 world = GetWorldMatrix();
+
+		bounds.Min = vec3(FLT_MAX);
+		bounds.Max = vec3(-FLT_MAX);
+
+		for (int i = 0; i < 8; i++)
+		{
+			vec3 corner = vec3(i & 1 ? localMax.x : localMin.x, i & 2 ? localMax.y : localMin.y, i & 4 ? localMax.z : localMin.z);
+			vec3 worldCorner = vec3(world * vec4(corner, 1.0f));
+
+			bounds.Min = min(bounds.Min, worldCorner);
+			bounds.Max = max(bounds.Max, worldCorner);
+		}
+
+		bounds.Center = (bounds.Min + bounds.Max) * 0.5f;
+		bounds.Radius = length(bounds.Max - bounds.Min) * 0.5f;
+
+		return true;
+	}
+
+	// Brushes are solid level geometry, the faces themselves make good occluders.
+	bool IsOccluder()
+	{
+		return Transparent == false && model != nullptr;
+	}
+
+	const vector<vec3>* GetOccluderTriangles()
+	{
+		if (IsOccluder() == false)
+			return nullptr;
+
+		if (hasOccluderTriangles == false)
+		{
+			mat4 world = GetWorldMatrix();
+
+			for (const auto& mesh : model->meshes)
+			{
+				size_t vertexCount = mesh.vertexLocations.size();
+
+				for (size_t i = 0; i + 2 < mesh.vertexIndices.size(); i += 3)
+				{
+					uint32_t a = mesh.vertexIndices[i];
+					uint32_t b = mesh.vertexIndices[i + 1];
+					uint32_t c = mesh.vertexIndices[i + 2];
+
+					if (a >= vertexCount || b >= vertexCount || c >= vertexCount)
+						continue;
+
+					occluderTriangles.push_back(vec3(world * vec4(mesh.vertexLocations[a].Position, 1.0f)));
+					occluderTriangles.push_back(vec3(world * vec4(mesh.vertexLocations[b].Position, 1.0f)));
+					occluderTriangles.push_back(vec3(world * vec4(mesh.vertexLocations[c].Position, 1.0f)));
+				}
+			}
+
+			hasOccluderTriangles = true;
+		}
+
+		return &occluderTriangles;
+	}
+
 	static vector<BrushFaceMesh*> GetMeshesFromName(string filePath, string name)
 	{
 
@@ -124,12 +213,16 @@ public:
             // Merge all meshes for this material
             MeshUtils::VerticesIndices merged = MeshUtils::MergeMeshes(VIs);
 
+            // faces were optimized one by one while loading, the merged mesh can weld and order across them
+            if (roj::LoaderGlobalParams::OptimizeMeshes)
+                MeshOptimizer::Optimize(merged.vertices, merged.indices);
+
             // Step 3: Create a new SkinnedMesh with the merged data
             roj::SkinnedMesh mergedMesh;
             mergedMesh.vertexLocations = merged.vertices; // Assign merged vertices
             mergedMesh.vertexIndices = merged.indices;   // Assign merged indices
 
-            mergedMesh.vertices = new VertexBuffer(mergedMesh.vertexLocations, VertexData::Declaration(), GL_STATIC_DRAW);
+            mergedMesh.vertices = CreatePackedVertexBuffer(mergedMesh.vertexLocations, false, GL_STATIC_DRAW);
             mergedMesh.indices = new IndexBuffer(mergedMesh.vertexIndices, GL_STATIC_DRAW);
 
             mergedMesh.VAO = new VertexArrayObject(*mergedMesh.vertices, *mergedMesh.indices);
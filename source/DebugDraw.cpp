@@ -1,6 +1,102 @@
 #include "DebugDraw.hpp"
 
-// Definitions for static members, usually in DebugDraw.cpp:
+#include "gl.h"
+#include "ShaderManager.h"
+#include "RenderState.h"
+
 std::mutex DebugDraw::mainLock;
-std::vector<std::unique_ptr<DebugDrawCommand>> DebugDraw::commands;
-std::vector<DebugDrawCommand*> DebugDraw::finalizedCommands;
\ No newline at end of file
+std::vector<DebugDraw::LineCommand> DebugDraw::commands;
+std::vector<DebugDraw::LineCommand> DebugDraw::finalizedCommands;
+
+std::vector<DebugDraw::LineVertex> DebugDraw::vertices;
+GLuint DebugDraw::vertexArray = 0;
+GLuint DebugDraw::vertexBuffer = 0;
+size_t DebugDraw::vertexCapacity = 0;
+
+const vec4 DebugDraw::DefaultColor = vec4(1, 0, 0, 1);
+
+void DebugDraw::InitBuffers()
+{
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &vertexBuffer);
+
+    RenderState::BindVertexArray(vertexArray);
+    RenderState::BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void*)offsetof(LineVertex, Position));
+
+    glEnableVertexAttribArray(8);
+    glVertexAttribPointer(8, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LineVertex), (void*)offsetof(LineVertex, Color));
+
+    RenderState::BindVertexArray(0);
+}
+
+void DebugDraw::AppendRibbon(const LineCommand& line, const vec3& cameraPosition)
+{
+    vec3 direction = line.End - line.Start;
+    vec3 toCamera = cameraPosition - (line.Start + line.End) * 0.5f;
+
+    vec3 side = cross(direction, toCamera);
+    float sideLength = length(side);
+
+    if (sideLength < 1e-6f)
+        return;
+
+    side *= line.Thickness * 0.5f / sideLength;
+
+    uint32_t color = packUnorm4x8(line.Color);
+
+    LineVertex a = { line.Start - side, color };
+    LineVertex b = { line.Start + side, color };
+    LineVertex c = { line.End + side, color };
+    LineVertex d = { line.End - side, color };
+
+    vertices.push_back(a);
+    vertices.push_back(b);
+    vertices.push_back(c);
+
+    vertices.push_back(a);
+    vertices.push_back(c);
+    vertices.push_back(d);
+}
+
+void DebugDraw::Draw(const mat4& view, const mat4& projection)
+{
+    if (finalizedCommands.empty())
+        return;
+
+    if (vertexArray == 0)
+        InitBuffers();
+
+    vec3 cameraPosition = vec3(inverse(view)[3]);
+
+    vertices.clear();
+    vertices.reserve(finalizedCommands.size() * 6);
+
+    for (const LineCommand& line : finalizedCommands)
+        AppendRibbon(line, cameraPosition);
+
+    if (vertices.empty())
+        return;
+
+    RenderState::BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+    // orphan every frame, growing when needed, so the upload never waits for last frame's draw
+    if (vertices.size() > vertexCapacity)
+        vertexCapacity = vertices.size() * 2;
+
+    glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(LineVertex), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(LineVertex), vertices.data());
+
+    ShaderProgram* shader = ShaderManager::GetShaderProgram("debug_line", "debug_line_pixel");
+    shader->UseProgram();
+
+    // ribbon winding depends on how the line runs relative to the camera
+    glDisable(GL_CULL_FACE);
+
+    RenderState::BindVertexArray(vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+
+    glEnable(GL_CULL_FACE);
+}
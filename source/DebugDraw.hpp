@@ -2,87 +2,86 @@
 
 #include <mutex>
 #include <vector>
-#include <memory>
 
-#include "StaticMesh.hpp"
-#include "glm.h"
 #include "gl.h"
+#include "glm.h"
 #include "Delay.hpp"
 
-class DebugDrawCommand
-{
-public:
-    DebugDrawCommand() {}
-    virtual ~DebugDrawCommand() {}
-
-    Delay DrawTime = Delay(0.2);
-
-    virtual void Draw() {}
-};
-
-class DrawCommandLine : public DebugDrawCommand
+// Immediate mode debug lines. Any thread appends lines with a lifetime; every frame the
+// live ones are expanded into camera facing ribbons, streamed into one vertex buffer and
+// drawn with a single call.
+class DebugDraw
 {
-    vec3 start;
-    vec3 end;
-    float thickness;
-    StaticMesh lineMesh;
-
+private:
 
-public:
-    DrawCommandLine(vec3 s, vec3 e, float th, double duration)
+    struct LineCommand
     {
-        start = s;
-        end = e;
-        thickness = th;
-
-        DrawTime = Delay(duration);
+        vec3 Start;
+        vec3 End;
+        vec4 Color;
+        float Thickness;
 
-        lineMesh.LoadFromFile("GameData/cube.obj");
-        lineMesh.SetPixelShader("solidRed_pixel");
+        Delay DrawTime;
+    };
 
-        lineMesh.Position = mix(s, e, 0.5);
-        lineMesh.Rotation = MathHelper::FindLookAtRotation(s, e);
+    struct LineVertex
+    {
+        vec3 Position;
+        uint32_t Color;
+    };
 
-        lineMesh.Scale.z = distance(s, e);
+    static std::mutex mainLock;
 
-        lineMesh.Scale.x = th;
-        lineMesh.Scale.y = th;
+    // live lines, appended to by any thread
+    static std::vector<LineCommand> commands;
 
-        lineMesh.FinalizeFrameData();
+    // copy of the live lines for the render thread
+    static std::vector<LineCommand> finalizedCommands;
 
-    }
+    // render thread only
+    static std::vector<LineVertex> vertices;
+    static GLuint vertexArray;
+    static GLuint vertexBuffer;
+    static size_t vertexCapacity;
 
-    void Draw() override
+    // callers hold mainLock
+    static void AddLine(vec3 start, vec3 end, float duration, float thickness, vec4 color)
     {
-        
-        lineMesh.DrawForward(Camera::finalizedView, Camera::finalizedProjection);
+        LineCommand command;
+        command.Start = start;
+        command.End = end;
+        command.Color = color;
+        command.Thickness = thickness;
+        command.DrawTime = Delay(duration);
+
+        commands.push_back(command);
     }
-};
 
-class DebugDraw
-{
-private:
-    static std::mutex mainLock;
+    static void AppendRibbon(const LineCommand& line, const vec3& cameraPosition);
+
+    static void InitBuffers();
 
-    // This container owns the commands.
-    static std::vector<std::unique_ptr<DebugDrawCommand>> commands;
-    // This container is a snapshot for the render thread; it does not own the objects.
-    static std::vector<DebugDrawCommand*> finalizedCommands;
+public:
+
+    static const vec4 DefaultColor;
 
-    static void AddCommand(std::unique_ptr<DebugDrawCommand> command)
+    // Called from any thread to add a line.
+    static void Line(vec3 start, vec3 end, float duration = 0.1f, float thickness = 0.02f, vec4 color = DefaultColor)
     {
         std::lock_guard<std::mutex> lock(mainLock);
-        commands.push_back(std::move(command));
+        AddLine(start, end, duration, thickness, color);
     }
 
-public:
-    // Called from any thread to add a draw command.
-    static void Line(vec3 start, vec3 end, float duration = 0.1f, float thickness = 0.02f)
+    // Adds a line between every pair of points, points[0]-points[1], points[2]-points[3] and so on.
+    static void Lines(const std::vector<vec3>& points, float duration = 0.1f, float thickness = 0.02f, vec4 color = DefaultColor)
     {
-        AddCommand(std::make_unique<DrawCommandLine>(start, end, thickness, duration));
+        std::lock_guard<std::mutex> lock(mainLock);
+
+        for (size_t i = 1; i < points.size(); i += 2)
+            AddLine(points[i - 1], points[i], duration, thickness, color);
     }
 
-    static void Bounds(vec3 min, vec3 max, float duration = 0.1f, float thickness = 0.02f)
+    static void Bounds(vec3 min, vec3 max, float duration = 0.1f, float thickness = 0.02f, vec4 color = DefaultColor)
     {
         vec3 p000 = { min.x, min.y, min.z };
         vec3 p001 = { min.x, min.y, max.z };
@@ -93,64 +92,71 @@ public:
         vec3 p110 = { max.x, max.y, min.z };
         vec3 p111 = { max.x, max.y, max.z };
 
-        // Bottom face
-        Line(p000, p100, duration, thickness);
-        Line(p100, p101, duration, thickness);
-        Line(p101, p001, duration, thickness);
-        Line(p001, p000, duration, thickness);
-
-        // Top face
-        Line(p010, p110, duration, thickness);
-        Line(p110, p111, duration, thickness);
-        Line(p111, p011, duration, thickness);
-        Line(p011, p010, duration, thickness);
-
-        // Vertical edges
-        Line(p000, p010, duration, thickness);
-        Line(p100, p110, duration, thickness);
-        Line(p101, p111, duration, thickness);
-        Line(p001, p011, duration, thickness);
+        Lines({
+            // Bottom face
+            p000, p100, p100, p101, p101, p001, p001, p000,
+            // Top face
+            p010, p110, p110, p111, p111, p011, p011, p010,
+            // Vertical edges
+            p000, p010, p100, p110, p101, p111, p001, p011
+            }, duration, thickness, color);
     }
 
-    static void Path(vector<vec3> path, float duration = 1, float thickness = 0.02f)
+    // Three circles around the axes.
+    static void Sphere(vec3 center, float radius, float duration = 0.1f, float thickness = 0.02f, vec4 color = DefaultColor)
     {
-        for (int i = 1; i < path.size(); i++)
+        const int segments = 16;
+
+        std::vector<vec3> points;
+        points.reserve(segments * 6);
+
+        for (int i = 0; i < segments; i++)
         {
-            Line(path[i - 1], path[i], duration, thickness);
+            float a0 = glm::two_pi<float>() * i / segments;
+            float a1 = glm::two_pi<float>() * (i + 1) / segments;
+
+            vec2 c0 = vec2(cos(a0), sin(a0)) * radius;
+            vec2 c1 = vec2(cos(a1), sin(a1)) * radius;
+
+            points.push_back(center + vec3(c0.x, c0.y, 0));
+            points.push_back(center + vec3(c1.x, c1.y, 0));
+
+            points.push_back(center + vec3(c0.x, 0, c0.y));
+            points.push_back(center + vec3(c1.x, 0, c1.y));
+
+            points.push_back(center + vec3(0, c0.x, c0.y));
+            points.push_back(center + vec3(0, c1.x, c1.y));
         }
+
+        Lines(points, duration, thickness, color);
     }
 
-    // This method is called to produce a snapshot for the render thread. It:
-    // 1. Removes expired commands from 'commands'
-    // 2. Copies pointers to the remaining commands into 'finalizedCommands'
-    static void Finalize()
+    static void Path(std::vector<vec3> path, float duration = 1, float thickness = 0.02f, vec4 color = DefaultColor)
     {
         std::lock_guard<std::mutex> lock(mainLock);
 
-        // Clear the previous snapshot.
-        finalizedCommands.clear();
-
-        // Remove expired commands
-        auto new_end = std::remove_if(commands.begin(), commands.end(),
-            [](const std::unique_ptr<DebugDrawCommand>& cmd) {
-                return !(cmd && cmd->DrawTime.Wait());
-            });
-        commands.erase(new_end, commands.end());
-
-        // Now collect raw pointers to active commands
-        for (const auto& cmd : commands) {
-            finalizedCommands.push_back(cmd.get());
+        for (size_t i = 1; i < path.size(); i++)
+        {
+            AddLine(path[i - 1], path[i], duration, thickness, color);
         }
     }
 
-    // Called by the render thread.
-    static void Draw()
+    // Produces the snapshot for the render thread: drops expired lines and copies the rest.
+    static void Finalize()
     {
-        // It is assumed that Finalize() is called before Draw() and that
-        // finalizedCommands remains consistent for the duration of rendering.
-        for (auto& command : finalizedCommands)
+        std::lock_guard<std::mutex> lock(mainLock);
+
+        size_t kept = 0;
+        for (size_t i = 0; i < commands.size(); i++)
         {
-            command->Draw();
+            if (commands[i].DrawTime.Wait())
+                commands[kept++] = commands[i];
         }
+        commands.resize(kept);
+
+        finalizedCommands = commands;
     }
-};
\ No newline at end of file
+
+    // Called by the render thread, after Finalize. Uses the FrameData block for the camera.
+    static void Draw(const mat4& view, const mat4& projection);
+};
@@ -27,15 +27,18 @@
 
 #include "SkeletalMesh.hpp"
 
-#include "ThreadPool.h"
+#include "JobScheduler.h"
 
-#include <future>
+#include "SimulationThread.h"
+
+#include "Profiler.h"
 
 #include <thread>
 
 #include "ImGuiEngineImpl.h"
 
 #include "DebugDraw.hpp"
+#include "ShadowMaps.h"
 
 #include "UI/UiButton.hpp"
 
@@ -69,8 +72,6 @@ public:
 
 	}
 
-    ThreadPool MainThreadPool;
-
     void ToggleFullscreen(SDL_Window* Window)
     {
         Uint32 FullscreenFlag = SDL_WINDOW_FULLSCREEN_DESKTOP;
@@ -118,12 +119,21 @@ public:
         printf("clicked \n");
     }
 
+	void Shutdown()
+	{
+        Simulation.Stop();
+
+        JobScheduler::Stop();
+	}
+
 	void Init()
 	{
 
         printf("init\n");
 
-        MainThreadPool.Start();
+        PROFILE_THREAD("Main");
+
+        JobScheduler::Start();
 
         SoundManager::Initialize();
 
@@ -131,14 +141,28 @@ public:
 
         Physics::Init();
 
+        ShaderManager::Init();
+
         UiRenderer::Init();
 
+        UniformBuffers::Init();
+
+        BoneTexture::Init();
+
+        InstanceBuffer::Init();
+
+        ShadowMaps::Init();
+
+        VertexArrayObject::InitDefaultAttributes();
+
         Level::OpenLevel("GameData/Maps/test.map");
 
         initDemo();
 
         InitInputs();
 
+        Simulation.Start([this]() { GameUpdate(); }, asyncGameUpdate);
+
 
         img = make_shared<UiButton>();
 
@@ -168,29 +192,40 @@ public:
 
 	}
 
-    // Toggle asynchronous GameUpdate.
+    // Run GameUpdate on the persistent simulation thread.
     bool asyncGameUpdate = true;
 
-    // Store the future of the async update.
-    std::future<void> gameUpdateFuture;
+    SimulationThread Simulation;
 
     // Main game loop.
     void MainLoop() {
 
+        Profiler::NewFrame();
+
+        RenderState::NewFrame();
+
+        ShaderManager::Update();
+
+        PROFILE_SCOPE("MainLoop");
 
         ImStartFrame();
 
-        // Wait for game update here
+        // With pipeline depth 2 the tick kicked last frame may still be running here.
+        {
+            PROFILE_SCOPE("WaitSimulation");
+            Simulation.Wait();
+        }
+
         Time::Update();
         Input::Update();
 
-        Camera::Update(Time::DeltaTime);
-        Level::Current->FinalizeFrame();
-        Viewport.FinalizeChildren();
+        if (Input::GetAction("fullscreen")->Pressed())
+        {
+            //ToggleFullscreen(Window);
 
-        //NavigationSystem::DrawNavmesh();
+            Level::OpenLevel("GameData/Maps/test.map");
 
-        DebugDraw::Finalize();
+        }
 
         int x, y;
         SDL_GetWindowSize(Window, &x, &y);
@@ -200,51 +235,41 @@ public:
         float AspectRatio = static_cast<float>(x) / static_cast<float>(y);
         Camera::AspectRatio = AspectRatio;
 
-        
-        Input::UpdateMouse();
+        // Camera and render packet were built at the end of the last tick.
+        FrameSnapshot frame = Simulation.GetReadSnapshot();
+        const RenderPacket& packet = Level::Current->GetRenderPacket();
 
-        // Start GameUpdate here, either asynchronously or synchronously.
-        if (asyncGameUpdate) {
-            // Optionally, check if a previous async GameUpdate is still running.
+        //NavigationSystem::DrawNavmesh();
 
-            // Launch GameUpdate asynchronously.
-            gameUpdateFuture = std::async(std::launch::async, &EngineMain::GameUpdate, this);
-        }
-        else {
-            // Run GameUpdate on the main thread.
-            GameUpdate();
-        }
+        DebugDraw::Finalize();
 
-        Render();
+        
+        Input::UpdateMouse();
 
+        // Simulation of the next frame overlaps rendering of this one.
+        Simulation.Kick();
 
-        if (asyncGameUpdate)
-        {
-            if (gameUpdateFuture.valid()) {
-                // If it's not done yet, wait (or you could choose to skip/warn).
-                if (gameUpdateFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
-                    gameUpdateFuture.wait();
-                }
-            }
-        }
-
+        Render(frame, packet);
 
-        if (Input::GetAction("fullscreen")->Pressed())
+        if (Simulation.PipelineDepth < 2)
         {
-            //ToggleFullscreen(Window);
-
-            Level::OpenLevel("GameData/Maps/test.map");
-
+            Simulation.Wait();
         }
 
-
+        SDL_GL_SwapWindow(Window);
 
     }
 
     bool msaa = false;
 
+    // lays down opaque depth first so the forward pass only shades visible pixels
+    bool depthPrepass = false;
+
 	void GameUpdate()
 	{
+        PROFILE_SCOPE("GameUpdate");
+
+        Level::Current->ApplyCommands();
 
         NavigationSystem::Update();
         Physics::Simulate();
@@ -268,11 +293,82 @@ public:
 
         }
 
+        Camera::Update(Time::DeltaTime);
+
+        Simulation.GetWriteSnapshot().CaptureCamera();
+
+        Level::Current->FinalizeFrame();
 
 	}
 
-	void Render()
+    // Opaque world geometry only. Instanced groups are left to the forward pass, their
+    // instanced vertex shader is not guaranteed to produce the exact same depth.
+    void DrawDepthPrepass(const FrameSnapshot& frame, const RenderPacket& packet)
+    {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+        for (const RenderItem& item : packet.Items)
+        {
+            if (item.Transparent || item.IsViewmodel || item.InstanceCount != 1)
+                continue;
+
+            item.Mesh->DrawDepth(item, packet, frame.View, frame.Projection);
+        }
+
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        // the forward pass redraws the same surfaces at the same depth
+        glDepthFunc(GL_LEQUAL);
+    }
+
+    void DrawRenderSettings(const RenderPacket& packet)
+    {
+        if (ImGui::Begin("Render Settings") == false)
+        {
+            ImGui::End();
+            return;
+        }
+
+        ImGui::Checkbox("Depth prepass", &depthPrepass);
+
+        bool occlusion = OcclusionBuffer::Enabled.load();
+        if (ImGui::Checkbox("Occlusion culling", &occlusion))
+            OcclusionBuffer::Enabled.store(occlusion);
+
+        ImGui::Text("Occluder triangles: %u", packet.Occlusion.OccluderTriangles);
+        ImGui::Text("Occlusion culled: %u / %u", packet.Occlusion.Culled, packet.Occlusion.Tested);
+
+        uint32_t shadowCasters = 0;
+        for (const ShadowView& view : packet.Shadows)
+            shadowCasters += view.DynamicCount;
+
+        ImGui::Text("Shadow views: %u, dynamic casters: %u", (uint32_t)packet.Shadows.size(), shadowCasters);
+        ImGui::Text("Static shadow rebuilds: %u", ShadowMaps::StaticRebuilds);
+
+        const UiRenderer::Stats& uiStats = UiRenderer::GetStats();
+        ImGui::Text("UI quads: %u, draw calls: %u", uiStats.Quads, uiStats.DrawCalls);
+
+        ImGui::Text("Shader programs compiling: %u", (uint32_t)ShaderManager::GetPendingCount());
+
+        ImGui::Text("GL state calls: %u issued, %u skipped", RenderState::LastFrame.Issued, RenderState::LastFrame.Skipped);
+
+        ImGui::End();
+    }
+
+	void Render(const FrameSnapshot& frame, const RenderPacket& packet)
 	{
+        PROFILE_SCOPE("Render");
+
+        UniformBuffers::UploadObjects(packet);
+        BoneTexture::Upload(packet);
+        InstanceBuffer::Upload(packet);
+
+        {
+            PROFILE_SCOPE("Shadows");
+            PROFILE_GPU_SCOPE("Shadows");
+
+            ShadowMaps::Render(packet);
+        }
 
         int x, y;
         SDL_GetWindowSize(Window, &x, &y);
@@ -306,31 +402,70 @@ public:
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
-        //printf("renderin %i meshes\n", Level::Current->VissibleRenderList.size());
+        //printf("renderin %i meshes\n", packet.Items.size());
 
-        for (IDrawMesh* mesh : Level::Current->VissibleRenderList)
-        {
+        UniformBuffers::SetFrame(frame.View, frame.Projection, frame.ProjectionViewmodel, frame.CameraPosition);
 
-            mat4 proj = mesh->IsViewmodel ? Camera::finalizedProjectionViewmodel : Camera::finalizedProjection;
+        if (depthPrepass)
+        {
+            PROFILE_SCOPE("Depth Prepass");
+            PROFILE_GPU_SCOPE("Depth Prepass");
 
-            mesh->DrawForward(Camera::finalizedView, proj);
+            DrawDepthPrepass(frame, packet);
         }
 
-        DebugDraw::Draw();
+        {
+            PROFILE_SCOPE("Forward");
+            PROFILE_GPU_SCOPE("Forward");
+
+            for (const RenderItem& item : packet.Items)
+            {
+                // drawn by its group leader
+                if (item.InstanceCount == 0)
+                    continue;
+
+                mat4 proj = item.IsViewmodel ? frame.ProjectionViewmodel : frame.Projection;
+
+                if (item.InstanceCount > 1)
+                    item.Mesh->DrawForwardInstanced(item, packet, frame.View, proj);
+                else
+                    item.Mesh->DrawForward(item, packet, frame.View, proj);
+            }
+
+            DebugDraw::Draw(frame.View, frame.Projection);
+
+            glDepthFunc(GL_LESS);
+        }
 
         bool showdemo = true;
 
         ImGui::ShowDemoWindow(&showdemo);
 
+        Profiler::DrawImGui();
+
+        DrawRenderSettings(packet);
+
         glDisable(GL_DEPTH_TEST);
 
-        Viewport.Update();
+        {
+            PROFILE_SCOPE("UI Viewport");
+            PROFILE_GPU_SCOPE("UI Viewport");
 
-        Viewport.Draw();
+            // the UI tree is render thread only, the simulation running next to this never touches it
+            Viewport.Update();
+            Viewport.FinalizeChildren();
 
-        RenderImGui();
+            UiRenderer::Begin();
+            Viewport.Draw();
+            UiRenderer::End();
+        }
 
-        SDL_GL_SwapWindow(Window);
+        {
+            PROFILE_SCOPE("ImGui");
+            PROFILE_GPU_SCOPE("ImGui");
+
+            RenderImGui();
+        }
 
 	}
 
@@ -0,0 +1,4 @@
+#include "LightSource.h"
+
+REGISTER_LEVEL_OBJECT(DirectionalLight, "light_directional")
+REGISTER_LEVEL_OBJECT(SpotLight, "light_spot")
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../Entity.hpp"
+
+#include "../MathHelper.hpp"
+#include "../RenderPacket.h"
+
+// Shadow casting light placed in the map. Properties, in engine units and degrees:
+// "angle" yaw and "pitch" (positive looks down) for the direction, "range" for how far it
+// reaches, "size" for the half width a directional light covers, "cone" for a spot light's
+// half angle, and "shadows" to switch it off.
+class LightSource : public Entity
+{
+public:
+
+	ShadowLight Light;
+
+	bool Shadows = true;
+
+	LightSource()
+	{
+		Static = true;
+	}
+
+	void FromData(EntityData data)
+	{
+		Entity::FromData(data);
+
+		float yaw = data.GetPropertyFloat("angle") - 90;
+		float pitch = data.GetPropertyFloat("pitch", Light.Type == ShadowLight::Directional ? 60.0f : 90.0f);
+
+		Rotation = vec3(pitch, yaw, 0);
+
+		Light.Position = Position;
+		Light.Direction = MathHelper::GetForwardVector(Rotation);
+
+		Light.Range = data.GetPropertyFloat("range", Light.Range);
+		Light.Extent = data.GetPropertyFloat("size", Light.Extent);
+		Light.OuterAngle = data.GetPropertyFloat("cone", Light.OuterAngle);
+
+		Shadows = data.GetPropertyBool("shadows", true);
+	}
+
+	bool GetShadowLight(ShadowLight& light)
+	{
+		if (Shadows == false)
+			return false;
+
+		light = Light;
+		return true;
+	}
+
+};
+
+class DirectionalLight : public LightSource
+{
+public:
+
+	DirectionalLight()
+	{
+		Light.Type = ShadowLight::Directional;
+		Light.Range = 100;
+	}
+
+};
+
+class SpotLight : public LightSource
+{
+public:
+
+	SpotLight()
+	{
+		Light.Type = ShadowLight::Spot;
+		Light.Range = 20;
+	}
+
+};
@@ -45,12 +45,25 @@ public:
 
 	}
 
+	// Position and Rotation follow the lead body blended between fixed physics steps,
+	// so they move smoothly at any frame rate. Read LeadBody for the exact simulated state.
 	void UpdatePhysics()
 	{
 		if (LeadBody)
 		{
-			Position = FromPhysics(LeadBody->GetPosition());
-			Rotation = MathHelper::ToYawPitchRoll(FromPhysics(LeadBody->GetRotation()));
+			Position = Physics::GetInterpolatedPosition(LeadBody);
+			Rotation = MathHelper::ToYawPitchRoll(Physics::GetInterpolatedRotation(LeadBody));
+		}
+	}
+
+	// bodies created before the entity joined the level could not know its handle yet
+	void OnAddedToLevel()
+	{
+		Physics::UpdateOwnerHandle(LeadBody, this);
+
+		for (Body* body : Bodies)
+		{
+			Physics::UpdateOwnerHandle(body, this);
 		}
 	}
 
@@ -63,15 +76,7 @@ public:
 
 	}
 
-	void Finalize()
-	{
-		for (IDrawMesh* mesh : Drawables)
-		{
-			mesh->FinalizeFrameData();
-		}
-	}
-
-	vector<IDrawMesh*> GetDrawMeshes()
+	const vector<IDrawMesh*>& GetDrawMeshes()
 	{
 		return Drawables;
 	}
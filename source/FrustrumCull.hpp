@@ -15,6 +15,19 @@ public:
 
 	bool IsSphereVisible(const glm::vec3& center, float radius) const;
 
+	enum BoxResult
+	{
+		BoxOutside,
+		BoxIntersects,
+		BoxInside
+	};
+
+	// Plane-only box test that also reports full containment, for hierarchical culling.
+	BoxResult ClassifyBox(const glm::vec3& minp, const glm::vec3& maxp) const;
+
+	// 6 normalized planes (left, right, bottom, top, near, far), xyz = normal, w = distance.
+	const glm::vec4* GetPlanes() const { return m_planes; }
+
 private:
 	enum Planes
 	{
@@ -135,6 +148,27 @@ inline bool Frustum::IsSphereVisible(const glm::vec3& center, float radius) cons
 	return true;
 }
 
+inline Frustum::BoxResult Frustum::ClassifyBox(const glm::vec3& minp, const glm::vec3& maxp) const
+{
+	BoxResult result = BoxInside;
+
+	for (int i = 0; i < Count; i++)
+	{
+		const glm::vec4& plane = m_planes[i];
+
+		// corner furthest along the plane normal, and the one furthest against it
+		glm::vec3 positive = glm::vec3(plane.x >= 0 ? maxp.x : minp.x, plane.y >= 0 ? maxp.y : minp.y, plane.z >= 0 ? maxp.z : minp.z);
+		glm::vec3 negative = glm::vec3(plane.x >= 0 ? minp.x : maxp.x, plane.y >= 0 ? minp.y : maxp.y, plane.z >= 0 ? minp.z : maxp.z);
+
+		if (glm::dot(plane, glm::vec4(positive, 1.0f)) < 0.0f)
+			return BoxOutside;
+
+		if (glm::dot(plane, glm::vec4(negative, 1.0f)) < 0.0f)
+			result = BoxIntersects;
+	}
+
+	return result;
+}
 
 template<Frustum::Planes a, Frustum::Planes b, Frustum::Planes c>
 inline glm::vec3 Frustum::intersection(const glm::vec3* crosses) const
@@ -0,0 +1,21 @@
+#version 300 es
+
+layout(location = 0) in vec3 Position;
+layout(location = 8) in vec4 Color;
+
+layout(std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 projectionViewmodel;
+	vec4 cameraPosition;
+};
+
+out vec4 v_color;
+
+void main()
+{
+    v_color = Color;
+
+    gl_Position = projection * view * vec4(Position, 1.0);
+}
@@ -1,10 +1,8 @@
 #version 300 es
 precision mediump float;
-
-uniform vec4 u_Color;
+in vec4 v_color;
 out vec4 FragColor;
 
-void main()
-{
-    FragColor = u_Color;
+void main() {
+    FragColor = v_color;
 }
@@ -1,10 +1,56 @@
 #version 300 es
 precision highp float;
+precision highp sampler2DShadow;
 in vec2 v_texcoord;
+in vec3 v_worldPosition;
 out vec4 FragColor;
 uniform sampler2D u_texture;  // Changed from "texture" to avoid keyword conflict
 
+// see ShadowMaps.h
+const int MAX_SHADOWS = 2;
+
+layout(std140) uniform ShadowData
+{
+	mat4 shadowMatrices[MAX_SHADOWS];
+	vec4 shadowParams[MAX_SHADOWS]; // x: used, y: depth bias, z: texel size
+};
+
+uniform sampler2DShadow shadowMap0;
+uniform sampler2DShadow shadowMap1;
+
+// 1 where the light reaches the pixel, 4 comparison filtered taps
+float SampleShadow(sampler2DShadow shadowMap, int index)
+{
+	if (shadowParams[index].x == 0.0)
+		return 1.0;
+
+	vec4 clip = shadowMatrices[index] * vec4(v_worldPosition, 1.0);
+	if (clip.w <= 0.0)
+		return 1.0;
+
+	vec3 coord = clip.xyz / clip.w * 0.5 + 0.5;
+
+	// outside the shadowed area
+	if (any(lessThan(coord, vec3(0.0))) || any(greaterThan(coord, vec3(1.0))))
+		return 1.0;
+
+	coord.z -= shadowParams[index].y;
+
+	float offset = shadowParams[index].z * 0.5;
+
+	float lit = texture(shadowMap, coord + vec3(-offset, -offset, 0.0));
+	lit += texture(shadowMap, coord + vec3(offset, -offset, 0.0));
+	lit += texture(shadowMap, coord + vec3(-offset, offset, 0.0));
+	lit += texture(shadowMap, coord + vec3(offset, offset, 0.0));
+
+	return lit * 0.25;
+}
+
 void main() {
-    FragColor = texture(u_texture, v_texcoord);
+    vec4 color = texture(u_texture, v_texcoord);
+
+    float lit = SampleShadow(shadowMap0, 0) * SampleShadow(shadowMap1, 1);
+
+    FragColor = vec4(color.rgb * mix(0.5, 1.0, lit), color.a);
     //FragColor = vec4(1,1,1,1);
-}
\ No newline at end of file
+}
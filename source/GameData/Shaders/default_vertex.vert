@@ -2,13 +2,27 @@
 layout(location = 0) in vec3 Position;
 layout(location = 2) in vec2 TextureCoordinate;
 out vec2 v_texcoord;
+out vec3 v_worldPosition;
 
-uniform mat4x4 world;
-uniform mat4x4 view;
-uniform mat4x4 projection;
+layout(std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 projectionViewmodel;
+    vec4 cameraPosition;
+};
+
+layout(std140) uniform ObjectData
+{
+    mat4 world;
+    ivec4 objectFlags;
+};
 
 void main() {
     v_texcoord = TextureCoordinate;
+
+    vec4 worldPosition = world * vec4(Position, 1.0);
+    v_worldPosition = worldPosition.xyz;
     
-    gl_Position = projection * view * world * vec4(Position, 1.0);
+    gl_Position = projection * view * worldPosition;
 }
\ No newline at end of file
@@ -3,22 +3,48 @@
 layout(location = 0) in vec3 Position;
 layout(location = 1) in vec3 Normal;
 layout(location = 2) in vec2 TextureCoordinate;
-layout(location = 5) in ivec4 boneIds; 
+layout(location = 5) in uvec4 boneIds;
 layout(location = 6) in vec4 weights;
-layout(location = 7) in vec3 smoothNormals;
+
+// the depth prepass and the forward pass link this shader with different pixel shaders
+invariant gl_Position;
 	
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 world;
+layout(std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 projectionViewmodel;
+	vec4 cameraPosition;
+};
+
+layout(std140) uniform ObjectData
+{
+	mat4 world;
+	ivec4 objectFlags; // x: viewmodel, y: first bone, z: bone count
+};
 	
-const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
-	
-uniform bool isViewmodel;
+
+// bone matrices of every skinned draw in the frame, 4 texels (columns) per matrix
+const int BONE_TEXTURE_WIDTH = 1024;
+uniform highp sampler2D bonePalette;
 
 out vec2 v_texcoord;
+out vec3 v_worldPosition;
 	
+mat4 GetBoneMatrix(int bone)
+{
+	int texel = (objectFlags.y + clamp(bone, 0, objectFlags.z - 1)) * 4;
+
+	ivec2 coord = ivec2(texel % BONE_TEXTURE_WIDTH, texel / BONE_TEXTURE_WIDTH);
+
+	return mat4(
+		texelFetch(bonePalette, coord, 0),
+		texelFetch(bonePalette, coord + ivec2(1, 0), 0),
+		texelFetch(bonePalette, coord + ivec2(2, 0), 0),
+		texelFetch(bonePalette, coord + ivec2(3, 0), 0));
+}
+
 mat4 GetBoneTransforms()
 {
 
@@ -31,14 +57,15 @@ mat4 GetBoneTransforms()
 
 	float sum = weights.x + weights.y + weights.z + weights.w;
 
-	if (sum < 0.05f)
+	// unskinned draws have no bones in the palette
+	if (sum < 0.05f || objectFlags.z == 0)
 		return identity;
 
 	mat4 mbones =
-		finalBonesMatrices[boneIds.x] * weights.x / sum +
-		finalBonesMatrices[boneIds.y] * weights.y / sum +
-		finalBonesMatrices[boneIds.z] * weights.z / sum +
-		finalBonesMatrices[boneIds.w] * weights.w / sum;
+		GetBoneMatrix(int(boneIds.x)) * weights.x / sum +
+		GetBoneMatrix(int(boneIds.y)) * weights.y / sum +
+		GetBoneMatrix(int(boneIds.z)) * weights.z / sum +
+		GetBoneMatrix(int(boneIds.w)) * weights.w / sum;
 
 	return mbones;
 }
@@ -50,10 +77,17 @@ void main()
 
     mat4 vertWorldTrans = world * boneTrans;
 
-    gl_Position = projection * view * vertWorldTrans * vec4(Position, 1.0);
+    bool isViewmodel = objectFlags.x != 0;
+
+    mat4 proj = isViewmodel ? projectionViewmodel : projection;
+
+    vec4 worldPosition = vertWorldTrans * vec4(Position, 1.0);
+
+    gl_Position = proj * view * worldPosition;
 
 	if(isViewmodel)
 	gl_Position.z*=0.01;
 
     v_texcoord = TextureCoordinate;
+    v_worldPosition = worldPosition.xyz;
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 300 es
+
+layout(location = 0) in vec3 Position;
+layout(location = 1) in vec3 Normal;
+layout(location = 2) in vec2 TextureCoordinate;
+
+// per instance, see InstanceData in VertexData.h
+layout(location = 9) in mat4 instanceWorld;
+
+layout(std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 projectionViewmodel;
+	vec4 cameraPosition;
+};
+
+out vec2 v_texcoord;
+out vec3 v_worldPosition;
+
+// Unskinned, non-viewmodel draws of skeletal.vert, many at once.
+void main()
+{
+    vec4 worldPosition = instanceWorld * vec4(Position, 1.0);
+
+    gl_Position = projection * view * worldPosition;
+
+    v_texcoord = TextureCoordinate;
+    v_worldPosition = worldPosition.xyz;
+}
@@ -3,14 +3,14 @@ precision mediump float;
 
 
 in vec2 v_TexCoord;
+in vec4 v_Color;
 
 uniform sampler2D u_Texture;
-uniform vec4 u_Color;
 
 out vec4 FragColor;
 
 void main()
 {
     vec4 texColor = texture(u_Texture, v_TexCoord);
-    FragColor = texColor * u_Color;
-}
+    FragColor = texColor * v_Color;
+}
\ No newline at end of file
@@ -2,14 +2,16 @@
 
 layout (location = 0) in vec2 a_Position;
 layout (location = 1) in vec2 a_TexCoord;
+layout (location = 2) in vec4 a_Color;
 
-uniform mat4 u_Model;
 uniform mat4 u_Projection;
 
 out vec2 v_TexCoord;
+out vec4 v_Color;
 
 void main()
 {
     v_TexCoord = a_TexCoord;
-    gl_Position = u_Projection * u_Model * vec4(a_Position, 0.0, 1.0);
+    v_Color = a_Color;
+    gl_Position = u_Projection * vec4(a_Position, 0.0, 1.0);
 }
\ No newline at end of file
@@ -11,6 +11,10 @@
 
 #include "MeshUtils.hpp"
 
+#include "RenderPacket.h"
+#include "BoundsTable.h"
+#include "ShaderManager.h"
+
 using namespace std;
 
 class IDrawMesh : public EObject
@@ -24,7 +28,32 @@ public:
 
 	bool StaticNavigation = false;
 
-	virtual ~IDrawMesh() {}
+	bool CastShadows = true;
+
+	// Lets StaticBatch take the geometry of the mesh when it belongs to a Static object at load.
+	bool AllowStaticBatch = true;
+
+	// Set by StaticBatch, the batch draws the geometry and the mesh is never registered for drawing.
+	bool StaticBatched = false;
+
+	// Not drawn beyond this distance from the camera to the bounds, 0 draws at any distance.
+	float MaxDrawDistance = 0;
+
+	// Not drawn while the bounds cover less than this fraction of the screen height.
+	float MinScreenSize = 0.002f;
+
+	// Row in the level's bounds table, -1 while not registered.
+	int BoundsRow = -1;
+	BoundsTable* boundsTable = nullptr;
+
+	// Set when the row has to be rewritten even if the transform did not change.
+	bool BoundsDirty = true;
+
+	virtual ~IDrawMesh()
+	{
+		if (boundsTable)
+			boundsTable->Remove(this);
+	}
 
 	virtual float GetDistanceToCamera()
 	{
@@ -34,19 +63,64 @@ public:
 	virtual vector<MeshUtils::PositionVerticesIndices> GetNavObstacleMeshes() { return vector<MeshUtils::PositionVerticesIndices>(); }
 
 
-	virtual void DrawForward(mat4x4 view, mat4x4 projection) {}
+	// Draw calls only read the item and packet captured for this frame, never the mesh's live state.
+	// The pass has already written view and projection into the FrameData uniform block
+	// (UniformBuffers.h); the arguments are the same matrices, for meshes using their own shaders.
+	virtual void DrawForward(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection) {}
+
+	virtual void DrawDepth(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection) {}
 
-	virtual void DrawDepth(mat4x4 view, mat4x4 projection) {}
+	virtual void DrawShadow(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection) {}
 
-	virtual void DrawShadow(mat4x4 view, mat4x4 projection) {}
+	// Whether the item can be drawn in one instanced draw together with an item of other.
+	// Called while the packet is built, on the simulation thread.
+	virtual bool CanInstanceWith(const RenderItem& item, const IDrawMesh& other, const RenderItem& otherItem) const { return false; }
 
-	virtual void FinalizeFrameData(){}
+	// Draws item.InstanceCount instances of the item, see RenderItem::InstanceCount.
+	virtual void DrawForwardInstanced(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection) {}
+
+	// Copies per-frame state into the item (and shared arrays of the packet). Runs on the simulation thread.
+	virtual void FinalizeFrameData(RenderItem& item, RenderPacket& packet) {}
+
+	// World space bounds, false if the mesh has none and should never be culled.
+	virtual bool GetWorldBounds(WorldBounds& bounds) { return false; }
+
+	// Rewrites this mesh's bounds table row if BoundsDirty is set and returns true if it did.
+	// Called every frame for dynamic meshes from worker threads, so overrides should only
+	// set BoundsDirty when something actually moved.
+	virtual bool UpdateBounds(BoundsTable& table, uint32_t row)
+	{
+		if (BoundsDirty == false)
+			return false;
+
+		BoundsDirty = false;
+
+		WorldBounds bounds;
+		if (GetWorldBounds(bounds))
+			table.SetBounds(row, bounds);
+		else
+			table.SetUnbounded(row);
+
+		return true;
+	}
+
+	// World space triangles (3 vertices each) that hide what is behind them, nullptr if the
+	// mesh should not be used as an occluder. Only asked of static meshes, on the simulation thread.
+	virtual const vector<vec3>* GetOccluderTriangles() { return nullptr; }
+
+	// Whether GetOccluderTriangles returns triangles, without building them.
+	virtual bool IsOccluder() { return false; }
 
 	virtual bool IsCameraVisible() { return IsInFrustrum(Camera::frustum); }
-	virtual bool IsShadowVisible() { return true; }
+	// Whether the mesh is drawn into shadow maps. Casters are culled against each light's
+	// frustum before this is asked.
+	virtual bool IsShadowVisible() { return CastShadows && Transparent == false && IsViewmodel == false; }
 
 	virtual bool IsInFrustrum(Frustum frustrum) { return true; };
 
+	// Programs the mesh draws with, compiled ahead of time when the level loads.
+	virtual void GetShaderPrograms(vector<ShaderManager::ProgramName>& programs) {}
+
 	virtual void RemoveFromLevel(){}
 
 };
\ No newline at end of file
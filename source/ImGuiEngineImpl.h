@@ -5,6 +5,7 @@
 #include "imgui/imgui_impl_opengl3.h"
 
 #include "gl.h"
+#include "RenderState.h"
 
 inline void ImStartFrame()
 {
@@ -19,6 +20,9 @@ inline void RenderImGui()
     // Rendering
     ImGui::Render();
 
-    glUseProgram(0); // You may want this if using this code in an OpenGL 3+ context where shaders may be bound
+    RenderState::UseProgram(0); // You may want this if using this code in an OpenGL 3+ context where shaders may be bound
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+    // the backend binds its own program, buffers and textures
+    RenderState::Invalidate();
 }
\ No newline at end of file
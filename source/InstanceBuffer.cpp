@@ -0,0 +1,49 @@
+#include "InstanceBuffer.h"
+
+#include "RenderPacket.h"
+#include "RenderState.h"
+
+GLuint InstanceBuffer::buffer = 0;
+uint32_t InstanceBuffer::capacity = 0;
+
+VertexDeclaration InstanceBuffer::declaration = InstanceData::Declaration();
+
+void InstanceBuffer::Init()
+{
+	glGenBuffers(1, &buffer);
+
+	capacity = 1024;
+
+	RenderState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+	RenderState::BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::Upload(const RenderPacket& packet)
+{
+	uint32_t count = (uint32_t)packet.InstanceWorlds.size();
+	if (count == 0)
+		return;
+
+	while (count > capacity)
+		capacity *= 2;
+
+	RenderState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	// orphan so last frame's instanced draws don't stall the upload
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), packet.InstanceWorlds.data());
+
+	RenderState::BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::BindInstances(uint32_t firstInstance)
+{
+	RenderState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+	VertexArrayObject::BindInstanceAttributes(declaration, (GLintptr)firstInstance * sizeof(InstanceData));
+}
+
+void InstanceBuffer::UnbindInstances()
+{
+	VertexArrayObject::UnbindInstanceAttributes(declaration);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#include "gl.h"
+
+#include "VertexData.h"
+
+struct RenderPacket;
+
+// Per instance world matrices of every instanced group in a packet, uploaded once per frame.
+class InstanceBuffer
+{
+public:
+
+	static void Init();
+
+	// Uploads packet.InstanceWorlds.
+	static void Upload(const RenderPacket& packet);
+
+	// Points the instance attributes of the bound VAO at the instances starting at firstInstance.
+	static void BindInstances(uint32_t firstInstance);
+
+	// Call after the instanced draws of a VAO, before it is drawn without instancing again.
+	static void UnbindInstances();
+
+private:
+
+	static GLuint buffer;
+
+	// in instances
+	static uint32_t capacity;
+
+	static VertexDeclaration declaration;
+
+};
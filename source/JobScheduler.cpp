@@ -0,0 +1,291 @@
+#include "JobScheduler.h"
+
+#include <string>
+
+#include "Profiler.h"
+
+#ifndef DISABLE_TREADPOOL
+
+std::vector<std::thread> JobScheduler::workers;
+std::vector<std::unique_ptr<JobScheduler::WorkerQueue>> JobScheduler::queues;
+JobScheduler::WorkerQueue JobScheduler::injectionQueue;
+
+std::atomic<int> JobScheduler::queuedJobs = 0;
+std::atomic<int> JobScheduler::sleepingWorkers = 0;
+std::atomic<bool> JobScheduler::shouldTerminate = false;
+
+std::mutex JobScheduler::sleepLock;
+std::condition_variable JobScheduler::wakeCondition;
+
+thread_local int JobScheduler::currentWorker = -1;
+
+#endif // !DISABLE_TREADPOOL
+
+void JobScheduler::Start()
+{
+#ifndef DISABLE_TREADPOOL
+
+	if (workers.size())
+		return;
+
+	// leave room for the main thread, the simulation and Jolt's own pool
+	const uint32_t num_threads = (std::thread::hardware_concurrency() - 1) / 1.5;
+
+	shouldTerminate = false;
+
+	for (uint32_t i = 0; i < num_threads; ++i)
+	{
+		queues.push_back(std::make_unique<WorkerQueue>());
+	}
+
+	for (uint32_t i = 0; i < num_threads; ++i)
+	{
+		workers.emplace_back(&JobScheduler::WorkerLoop, (int)i);
+	}
+
+#endif // !DISABLE_TREADPOOL
+}
+
+void JobScheduler::Stop()
+{
+#ifndef DISABLE_TREADPOOL
+
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+		shouldTerminate = true;
+	}
+	wakeCondition.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	workers.clear();
+	queues.clear();
+
+#endif // !DISABLE_TREADPOOL
+}
+
+int JobScheduler::GetWorkerCount()
+{
+#ifdef DISABLE_TREADPOOL
+	return 0;
+#else
+	return (int)workers.size();
+#endif
+}
+
+bool JobScheduler::IsBusy()
+{
+#ifdef DISABLE_TREADPOOL
+	return false;
+#else
+	return queuedJobs.load(std::memory_order_relaxed) > 0;
+#endif
+}
+
+void JobScheduler::Dispatch(Job job, JobCounter* counter)
+{
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	Enqueue(QueuedJob{ std::move(job), counter });
+}
+
+void JobScheduler::DispatchAfter(JobCounter* dependency, Job job, JobCounter* counter)
+{
+	// counted right away so waiting on counter also covers jobs that are still held back
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	if (dependency)
+	{
+		std::lock_guard<std::mutex> lock(dependency->continuationLock);
+
+		if (dependency->pending.load(std::memory_order_acquire) != 0)
+		{
+			dependency->continuations.push_back(JobCounter::Continuation{ std::move(job), counter });
+			return;
+		}
+	}
+
+	Enqueue(QueuedJob{ std::move(job), counter });
+}
+
+void JobScheduler::Wait(JobCounter* counter)
+{
+	if (counter == nullptr)
+		return;
+
+	while (!counter->IsDone())
+	{
+#ifndef DISABLE_TREADPOOL
+
+		QueuedJob job;
+		if (TryPop(job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::this_thread::yield();
+
+#endif // !DISABLE_TREADPOOL
+	}
+
+	// the finishing thread may still hold the lock right after the last decrement
+	std::lock_guard<std::mutex> lock(counter->continuationLock);
+}
+
+void JobScheduler::Execute(QueuedJob& job)
+{
+	job.job();
+
+	if (job.counter)
+		FinishJob(job.counter);
+}
+
+void JobScheduler::FinishJob(JobCounter* counter)
+{
+	std::vector<JobCounter::Continuation> ready;
+
+	{
+		std::lock_guard<std::mutex> lock(counter->continuationLock);
+
+		if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			ready.swap(counter->continuations);
+	}
+
+	// counter must not be touched past this point, a waiter is free to destroy it
+
+	for (auto& continuation : ready)
+	{
+		Enqueue(QueuedJob{ std::move(continuation.job), continuation.counter });
+	}
+}
+
+void JobScheduler::Enqueue(QueuedJob&& job)
+{
+
+#ifdef DISABLE_TREADPOOL
+	Execute(job);
+#else
+
+	if (workers.empty())
+	{
+		Execute(job);
+		return;
+	}
+
+	WorkerQueue& queue = currentWorker >= 0 ? *queues[currentWorker] : injectionQueue;
+
+	{
+		std::lock_guard<std::mutex> lock(queue.lock);
+		queue.jobs.push_back(std::move(job));
+	}
+
+	queuedJobs.fetch_add(1);
+
+	if (sleepingWorkers.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepLock);
+		}
+		wakeCondition.notify_one();
+	}
+
+#endif // DISABLE_TREADPOOL
+
+}
+
+#ifndef DISABLE_TREADPOOL
+
+bool JobScheduler::TryPopOwn(int index, QueuedJob& outJob)
+{
+	WorkerQueue& queue = *queues[index];
+
+	std::lock_guard<std::mutex> lock(queue.lock);
+	if (queue.jobs.empty())
+		return false;
+
+	outJob = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	queuedJobs.fetch_sub(1);
+	return true;
+}
+
+bool JobScheduler::TrySteal(int thief, QueuedJob& outJob)
+{
+	{
+		std::lock_guard<std::mutex> lock(injectionQueue.lock);
+		if (injectionQueue.jobs.size())
+		{
+			outJob = std::move(injectionQueue.jobs.front());
+			injectionQueue.jobs.pop_front();
+			queuedJobs.fetch_sub(1);
+			return true;
+		}
+	}
+
+	const int count = (int)queues.size();
+	const int first = thief < 0 ? 0 : thief + 1;
+
+	for (int i = 0; i < count; i++)
+	{
+		int victim = (first + i) % count;
+		if (victim == thief)
+			continue;
+
+		WorkerQueue& queue = *queues[victim];
+
+		std::lock_guard<std::mutex> lock(queue.lock);
+		if (queue.jobs.empty())
+			continue;
+
+		outJob = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+		queuedJobs.fetch_sub(1);
+		return true;
+	}
+
+	return false;
+}
+
+bool JobScheduler::TryPop(QueuedJob& outJob)
+{
+	if (currentWorker >= 0 && TryPopOwn(currentWorker, outJob))
+		return true;
+
+	return TrySteal(currentWorker, outJob);
+}
+
+void JobScheduler::WorkerLoop(int index)
+{
+	currentWorker = index;
+
+	PROFILE_THREAD(("Worker " + std::to_string(index)).c_str());
+
+	while (true)
+	{
+		QueuedJob job;
+		if (TryPop(job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepLock);
+
+		sleepingWorkers.fetch_add(1);
+		wakeCondition.wait(lock, [] {
+			return queuedJobs.load() > 0 || shouldTerminate.load();
+			});
+		sleepingWorkers.fetch_sub(1);
+
+		if (shouldTerminate)
+			return;
+	}
+}
+
+#endif // !DISABLE_TREADPOOL
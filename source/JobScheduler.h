@@ -0,0 +1,263 @@
+#pragma once
+
+#ifdef __EMSCRIPTEN__
+
+#define DISABLE_TREADPOOL
+
+#endif // __EMSCRIPTEN__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef DISABLE_TREADPOOL
+#include <condition_variable>
+#include <thread>
+#endif // !DISABLE_TREADPOOL
+
+// Move-only callable with inline storage. Lambdas that capture a few pointers or
+// values are stored in place, bigger ones fall back to a single heap allocation.
+class Job
+{
+public:
+
+	static constexpr size_t InlineSize = 48;
+
+	Job() = default;
+
+	template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Job>>>
+	Job(F&& func)
+	{
+		using T = std::decay_t<F>;
+
+		if constexpr (sizeof(T) <= InlineSize && alignof(T) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<T>)
+		{
+			new (storage) T(std::forward<F>(func));
+
+			invokeFn = [](void* s) { (*static_cast<T*>(s))(); };
+			manageFn = [](void* dst, void* src)
+				{
+					if (dst)
+						new (dst) T(std::move(*static_cast<T*>(src)));
+					static_cast<T*>(src)->~T();
+				};
+		}
+		else
+		{
+			*reinterpret_cast<T**>(storage) = new T(std::forward<F>(func));
+
+			invokeFn = [](void* s) { (**static_cast<T**>(s))(); };
+			manageFn = [](void* dst, void* src)
+				{
+					T** heapFunc = static_cast<T**>(src);
+					if (dst)
+						*static_cast<T**>(dst) = *heapFunc;
+					else
+						delete *heapFunc;
+				};
+		}
+	}
+
+	Job(Job&& other) noexcept
+	{
+		MoveFrom(other);
+	}
+
+	Job& operator=(Job&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Reset();
+			MoveFrom(other);
+		}
+		return *this;
+	}
+
+	Job(const Job&) = delete;
+	Job& operator=(const Job&) = delete;
+
+	~Job()
+	{
+		Reset();
+	}
+
+	explicit operator bool() const { return invokeFn != nullptr; }
+
+	void operator()() { invokeFn(storage); }
+
+private:
+
+	alignas(std::max_align_t) unsigned char storage[InlineSize];
+
+	void (*invokeFn)(void*) = nullptr;
+	void (*manageFn)(void* dst, void* src) = nullptr; // moves src into dst, or destroys src when dst is null
+
+	void MoveFrom(Job& other)
+	{
+		if (other.manageFn)
+			other.manageFn(storage, other.storage);
+
+		invokeFn = other.invokeFn;
+		manageFn = other.manageFn;
+
+		other.invokeFn = nullptr;
+		other.manageFn = nullptr;
+	}
+
+	void Reset()
+	{
+		if (manageFn)
+			manageFn(nullptr, storage);
+
+		invokeFn = nullptr;
+		manageFn = nullptr;
+	}
+};
+
+// Counts unfinished jobs of a group. Jobs dispatched with JobScheduler::DispatchAfter
+// are held back until the counter they depend on drops to zero.
+// A counter must not be destroyed before JobScheduler::Wait on it has returned.
+class JobCounter
+{
+public:
+
+	JobCounter() = default;
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const
+	{
+		return pending.load(std::memory_order_acquire) == 0;
+	}
+
+private:
+
+	friend class JobScheduler;
+
+	struct Continuation
+	{
+		Job job;
+		JobCounter* counter = nullptr;
+	};
+
+	std::atomic<int> pending = 0;
+
+	std::mutex continuationLock;
+	std::vector<Continuation> continuations;
+};
+
+// Work-stealing job scheduler. Every worker owns a deque: it pushes and pops its own
+// jobs LIFO and steals the oldest jobs of other workers when it runs dry. Threads that
+// are not workers (main, simulation) push into a shared injection queue and help out
+// while they Wait.
+class JobScheduler
+{
+public:
+
+	static void Start();
+	static void Stop();
+
+	// Queues a job. The counter, if any, is incremented now and decremented once the job has run.
+	static void Dispatch(Job job, JobCounter* counter = nullptr);
+
+	// Queues a job that only becomes runnable after every job tracked by dependency has finished.
+	static void DispatchAfter(JobCounter* dependency, Job job, JobCounter* counter = nullptr);
+
+	// Blocks until counter reaches zero. The calling thread runs queued jobs meanwhile.
+	static void Wait(JobCounter* counter);
+
+	// Runs fn(start, end) over [0, count) split into chunks of at least grain items and returns
+	// once all chunks are done. The calling thread processes the first chunk itself.
+	template<typename F>
+	static void ParallelFor(uint32_t count, uint32_t grain, const F& fn)
+	{
+		if (count == 0)
+			return;
+
+		grain = std::max<uint32_t>(grain, 1);
+
+		uint32_t maxChunks = (uint32_t)(GetWorkerCount() + 1) * 4;
+		if ((count + grain - 1) / grain > maxChunks)
+			grain = (count + maxChunks - 1) / maxChunks;
+
+		if (GetWorkerCount() == 0 || count <= grain)
+		{
+			fn(0u, count);
+			return;
+		}
+
+		JobCounter counter;
+
+		for (uint32_t start = grain; start < count; start += grain)
+		{
+			uint32_t end = std::min(count, start + grain);
+			Dispatch([&fn, start, end]() { fn(start, end); }, &counter);
+		}
+
+		fn(0u, grain);
+
+		Wait(&counter);
+	}
+
+	static bool IsBusy();
+
+	static int GetWorkerCount();
+
+	static inline bool Supported()
+	{
+#ifdef DISABLE_TREADPOOL
+		return false;
+#endif // DISABLE_TREADPOOL
+		return true;
+	}
+
+private:
+
+	struct QueuedJob
+	{
+		Job job;
+		JobCounter* counter = nullptr;
+	};
+
+	static void Enqueue(QueuedJob&& job);
+	static void Execute(QueuedJob& job);
+	static void FinishJob(JobCounter* counter);
+
+#ifndef DISABLE_TREADPOOL
+
+	struct WorkerQueue
+	{
+		std::mutex lock;
+		std::deque<QueuedJob> jobs;
+	};
+
+	static void WorkerLoop(int index);
+	static bool TryPop(QueuedJob& outJob);
+	static bool TryPopOwn(int index, QueuedJob& outJob);
+	static bool TrySteal(int thief, QueuedJob& outJob);
+
+	static std::vector<std::thread> workers;
+	static std::vector<std::unique_ptr<WorkerQueue>> queues; // one per worker
+	static WorkerQueue injectionQueue;                       // jobs pushed by non-worker threads
+
+	static std::atomic<int> queuedJobs;
+	static std::atomic<int> sleepingWorkers;
+	static std::atomic<bool> shouldTerminate;
+
+	static std::mutex sleepLock;
+	static std::condition_variable wakeCondition;
+
+	static thread_local int currentWorker; // -1 on non-worker threads
+
+#endif // !DISABLE_TREADPOOL
+
+};
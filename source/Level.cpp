@@ -4,22 +4,72 @@
 #include "MapParser.h"
 
 #include "Physics.h"
+#include "ShadowMaps.h"
+#include "StaticBatch.h"
 
 Level* Level::Current = nullptr;
 
 void Level::CloseLevel()
 {
+	// objects that were queued but never joined the level
+	Current->pendingCommands.clear();
+	LevelCommands::Collect(Current->pendingCommands);
+
+	for (auto& command : Current->pendingCommands)
+	{
+		if (command.CommandType == LevelCommands::Type::Spawn)
+		{
+			command.Object->Dispose();
+			delete(command.Object);
+		}
+	}
+	Current->pendingCommands.clear();
+
+	Current->DeleteRetiredObjects(true);
+
 	for (LevelObject* obj : Current->LevelObjects)
 	{
 		obj->Dispose();
 		delete(obj);
 	}
-	Current->LevelObjects.clear();
+	Current->LevelObjects.Clear();
 
 	Physics::DestroyAllBodies();
 
 }
 
+void Level::BuildStaticBatch()
+{
+	vector<LevelObject*> objects;
+
+	entityArrayLock.lock();
+	for (LevelObject* obj : LevelObjects)
+	{
+		objects.push_back(obj);
+	}
+	entityArrayLock.unlock();
+
+	StaticBatch* batch = StaticBatch::Build(objects);
+
+	if (batch)
+		AddEntity(batch);
+}
+
+void Level::PrewarmShaders()
+{
+	vector<ShaderManager::ProgramName> programs = ShaderManager::LoadManifest("GameData/Shaders/prewarm.txt");
+
+	entityArrayLock.lock();
+	for (LevelObject* obj : LevelObjects)
+	{
+		for (IDrawMesh* mesh : obj->GetDrawMeshes())
+			mesh->GetShaderPrograms(programs);
+	}
+	entityArrayLock.unlock();
+
+	ShaderManager::Prewarm(programs);
+}
+
 Level* Level::OpenLevel(string filePath)
 {
 	if (Current)
@@ -33,6 +83,9 @@ Level* Level::OpenLevel(string filePath)
 
 	Level* newLevel = new Level();
 
+	// the new level's static keys start over and could match the old level's
+	ShadowMaps::InvalidateStatic();
+
 	Current = newLevel;
 
 	MapData mapData = MapParser::ParseMap(filePath);
@@ -44,6 +97,10 @@ Level* Level::OpenLevel(string filePath)
 		obj->Start();
 	}
 
+	Current->BuildStaticBatch();
+
+	Current->PrewarmShaders();
+
 	printf("generating nav mesh");
 
 	NavigationSystem::GenerateNavData();
@@ -7,6 +7,18 @@
 #include "IDrawMesh.h"
 
 #include "mutex"
+#include <atomic>
+#include <algorithm>
+#include <cfloat>
+
+#include "RenderPacket.h"
+#include "BoundsTable.h"
+#include "OcclusionBuffer.h"
+#include "JobScheduler.h"
+#include "RenderSort.hpp"
+#include "SlotMap.hpp"
+#include "LevelCommands.h"
+#include "Profiler.h"
 
 #include "Navigation/Navigation.hpp"
 
@@ -18,16 +30,413 @@ class Level : EObject
 {
 
 private:
-	vector<LevelObject*> LevelObjects = vector<LevelObject*>();
+	// dense for iteration, O(1) add and remove through LevelObject::Handle
+	SlotMap<LevelObject*> LevelObjects;
 
+	// guards structural changes; Update iterates without it since those only happen in ApplyCommands
 	mutex entityArrayLock = mutex();
 
+	vector<LevelCommands::Command> pendingCommands;
+
+	// Removed objects are kept alive until no render packet can reference their drawables.
+	struct RetiredObject
+	{
+		LevelObject* Object;
+		uint64_t PacketFrame;
+	};
+
+	vector<RetiredObject> retiredObjects;
+
+	// Deletes retired objects whose last packet render is done, or all of them.
+	void DeleteRetiredObjects(bool all)
+	{
+		size_t kept = 0;
+
+		for (RetiredObject& retired : retiredObjects)
+		{
+			// the packet built after the removal never had them, the one before it is rendered by now
+			if (all || packetFrame > retired.PacketFrame)
+			{
+				retired.Object->Dispose();
+				delete(retired.Object);
+			}
+			else
+			{
+				retiredObjects[kept++] = retired;
+			}
+		}
+
+		retiredObjects.resize(kept);
+	}
+
+	// FinalizeFrame fills the slot render is not reading, then flips publishedPacket.
+	// The frame pipeline guarantees at most one packet is being built while render reads the other.
+	RenderPacket renderPackets[2];
+	atomic<int> publishedPacket = 0;
+
+	uint64_t packetFrame = 0;
+
+	// drawables of Static objects never move, the rest are refreshed every frame
+	BoundsTable staticBounds = BoundsTable(true);
+	BoundsTable dynamicBounds = BoundsTable(false);
+
+	// nearest static occluders, rasterized each frame to cull what they hide
+	OcclusionBuffer occlusionBuffer;
+
+	static const uint32_t OccluderTriangleBudget = 16384;
+
+	struct OccluderCandidate
+	{
+		float Distance;
+		const vector<vec3>* Triangles;
+	};
+
+	// shadow casting lights of this frame and the StaticKey each shadow view had in the last packet
+	vector<ShadowLight> shadowLights;
+	vector<uint64_t> shadowKeys;
+	vector<uint32_t> shadowRows;
+
+	// reused between frames to avoid reallocating
+	vector<OccluderCandidate> occluderCandidates;
+	vector<uint8_t> occlusionVisible;
+	vector<RenderItem> visibleItems;
+	vector<RenderSort::KeyIndex> sortEntries;
+	vector<RenderSort::KeyIndex> sortScratch;
+
+	// 1 / tan(FOV / 2) of this frame's camera, see GetScreenSize
+	float screenSizeScale = 1;
+
+	// Fraction of the screen height the row's bounding sphere covers.
+	float GetScreenSize(const BoundsTable& table, uint32_t row) const
+	{
+		float radius = table.Radius[row];
+		if (radius == FLT_MAX)
+			return FLT_MAX;
+
+		vec3 center = vec3(table.CenterX[row], table.CenterY[row], table.CenterZ[row]);
+		float distance = length(center - Camera::position);
+
+		// camera inside the bounds
+		if (distance <= radius)
+			return FLT_MAX;
+
+		return radius / distance * screenSizeScale;
+	}
+
+	// Drops visible rows beyond their mesh's MaxDrawDistance or below its MinScreenSize.
+	void CullDistant(BoundsTable& table)
+	{
+		uint32_t kept = 0;
+
+		for (uint32_t row : table.VisibleRows)
+		{
+			IDrawMesh* mesh = table.Meshes[row];
+
+			if (mesh->IsViewmodel == false && table.Radius[row] != FLT_MAX)
+			{
+				vec3 center = vec3(table.CenterX[row], table.CenterY[row], table.CenterZ[row]);
+				float distance = length(center - Camera::position) - table.Radius[row];
+
+				if (mesh->MaxDrawDistance > 0 && distance > mesh->MaxDrawDistance)
+					continue;
+
+				if (GetScreenSize(table, row) < mesh->MinScreenSize)
+					continue;
+			}
+
+			table.VisibleRows[kept++] = row;
+		}
+
+		table.VisibleRows.resize(kept);
+	}
+
+	void AddVisibleItems(BoundsTable& table, RenderPacket& packet)
+	{
+		for (uint32_t row : table.VisibleRows)
+		{
+			IDrawMesh* mesh = table.Meshes[row];
+
+			RenderItem item;
+			item.Mesh = mesh;
+			item.IsViewmodel = mesh->IsViewmodel;
+			item.Transparent = mesh->Transparent;
+			item.Distance = mesh->GetDistanceToCamera();
+			item.ScreenSize = GetScreenSize(table, row);
+
+			mesh->FinalizeFrameData(item, packet);
+
+			item.SortKey = RenderSort::MakeKey(item.Transparent, item.IsViewmodel, item.ShaderId, item.MaterialId, item.Distance);
+
+			sortEntries.push_back({ item.SortKey, (uint32_t)visibleItems.size() });
+			visibleItems.push_back(item);
+
+			LevelObject* owner = table.Owners[row];
+
+			if (owner->FinalizedFrame != packet.Frame)
+			{
+				owner->FinalizedFrame = packet.Frame;
+				owner->Finalize();
+			}
+		}
+	}
+
+	// Turns runs of sorted items that can be drawn together into instanced groups.
+	// Identical draws share their sort key down to the depth bits, so they are adjacent.
+	void BuildInstanceGroups(RenderPacket& packet)
+	{
+		size_t count = packet.Items.size();
+
+		size_t start = 0;
+		while (start < count)
+		{
+			RenderItem& leader = packet.Items[start];
+
+			size_t end = start + 1;
+			while (end < count && leader.Mesh->CanInstanceWith(leader, *packet.Items[end].Mesh, packet.Items[end]))
+				end++;
+
+			if (end - start > 1)
+			{
+				leader.InstanceCount = (uint32_t)(end - start);
+				leader.InstanceOffset = (uint32_t)packet.InstanceWorlds.size();
+
+				for (size_t i = start; i < end; i++)
+				{
+					packet.InstanceWorlds.push_back(packet.Items[i].World);
+
+					if (i != start)
+						packet.Items[i].InstanceCount = 0;
+				}
+			}
+
+			start = end;
+		}
+	}
+
+	// Rasterizes the frustum visible static occluders, nearest first, up to the triangle budget.
+	void RasterizeOccluders()
+	{
+		PROFILE_SCOPE("RasterizeOccluders");
+
+		occlusionBuffer.Begin(Camera::finalizedProjection * Camera::finalizedView);
+
+		occluderCandidates.clear();
+
+		for (uint32_t row : staticBounds.VisibleRows)
+		{
+			IDrawMesh* mesh = staticBounds.Meshes[row];
+
+			if (mesh->IsViewmodel || staticBounds.Radius[row] == FLT_MAX)
+				continue;
+
+			const vector<vec3>* triangles = mesh->GetOccluderTriangles();
+			if (triangles == nullptr || triangles->empty())
+				continue;
+
+			vec3 center = vec3(staticBounds.CenterX[row], staticBounds.CenterY[row], staticBounds.CenterZ[row]);
+			float distance = length(center - Camera::position) - staticBounds.Radius[row];
+
+			occluderCandidates.push_back({ distance, triangles });
+		}
+
+		sort(occluderCandidates.begin(), occluderCandidates.end(),
+			[](const OccluderCandidate& a, const OccluderCandidate& b) { return a.Distance < b.Distance; });
+
+		for (const OccluderCandidate& candidate : occluderCandidates)
+		{
+			if (occlusionBuffer.GetTriangleCount() + candidate.Triangles->size() / 3 > OccluderTriangleBudget)
+				continue;
+
+			occlusionBuffer.AddOccluder(*candidate.Triangles);
+		}
+
+		occlusionBuffer.Rasterize();
+	}
+
+	// Drops the table's visible rows hidden behind the occluders.
+	void CullOccluded(BoundsTable& table)
+	{
+		PROFILE_SCOPE("CullOccluded");
+
+		uint32_t count = (uint32_t)table.VisibleRows.size();
+		occlusionVisible.resize(count);
+
+		JobScheduler::ParallelFor(count, 128, [this, &table](uint32_t start, uint32_t end)
+			{
+				for (uint32_t i = start; i < end; i++)
+				{
+					uint32_t row = table.VisibleRows[i];
+
+					// viewmodels are drawn with their own projection over everything
+					if (table.Meshes[row]->IsViewmodel || table.Radius[row] == FLT_MAX)
+					{
+						occlusionVisible[i] = 1;
+						continue;
+					}
+
+					vec3 min = vec3(table.MinX[row], table.MinY[row], table.MinZ[row]);
+					vec3 max = vec3(table.MaxX[row], table.MaxY[row], table.MaxZ[row]);
+
+					occlusionVisible[i] = occlusionBuffer.IsBoxVisible(min, max) ? 1 : 0;
+				}
+			});
+
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (occlusionVisible[i])
+				table.VisibleRows[kept++] = table.VisibleRows[i];
+		}
+
+		table.VisibleRows.resize(kept);
+
+		occlusionBuffer.Current.Tested += count;
+		occlusionBuffer.Current.Culled += count - kept;
+	}
+
+	void CollectShadowLights()
+	{
+		lock_guard<mutex> guard(entityArrayLock);
+
+		shadowLights.clear();
+
+		for (auto obj : LevelObjects)
+		{
+			ShadowLight light;
+			if (obj->GetShadowLight(light))
+				shadowLights.push_back(light);
+		}
+	}
+
+	static uint64_t HashShadowView(const mat4& view, const mat4& projection, uint32_t staticRevision)
+	{
+		// FNV-1a over the matrices
+		uint64_t hash = 14695981039346656037ull;
+
+		const mat4* matrices[2] = { &view, &projection };
+		for (const mat4* matrix : matrices)
+		{
+			const uint8_t* bytes = (const uint8_t*)value_ptr(*matrix);
+			for (size_t i = 0; i < sizeof(mat4); i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+		}
+
+		hash ^= staticRevision;
+		hash *= 1099511628211ull;
+
+		return hash;
+	}
+
+	// Adds the rows that cast shadows to packet.ShadowItems.
+	void AddShadowItems(BoundsTable& table, const vector<uint32_t>& rows, RenderPacket& packet)
+	{
+		for (uint32_t row : rows)
+		{
+			IDrawMesh* mesh = table.Meshes[row];
+
+			if (mesh->IsShadowVisible() == false)
+				continue;
+
+			RenderItem item;
+			item.Mesh = mesh;
+			item.ScreenSize = GetScreenSize(table, row);
+
+			mesh->FinalizeFrameData(item, packet);
+
+			packet.ShadowItems.push_back(item);
+
+			LevelObject* owner = table.Owners[row];
+
+			if (owner->FinalizedFrame != packet.Frame)
+			{
+				owner->FinalizedFrame = packet.Frame;
+				owner->Finalize();
+			}
+		}
+	}
+
+	// One shadow view per light, up to RenderPacket::MaxShadowViews. Dynamic casters are culled
+	// every frame, static casters only when the view's StaticKey differs from the last packet's.
+	void BuildShadowViews(RenderPacket& packet)
+	{
+		PROFILE_SCOPE("BuildShadowViews");
+
+		CollectShadowLights();
+
+		vec3 cameraPosition = Camera::position;
+
+		sort(shadowLights.begin(), shadowLights.end(), [cameraPosition](const ShadowLight& a, const ShadowLight& b)
+			{
+				if (a.Type != b.Type)
+					return a.Type == ShadowLight::Directional;
+
+				return distance(a.Position, cameraPosition) < distance(b.Position, cameraPosition);
+			});
+
+		size_t viewCount = std::min(shadowLights.size(), (size_t)RenderPacket::MaxShadowViews);
+
+		shadowKeys.resize(viewCount, 0);
+
+		for (size_t i = 0; i < viewCount; i++)
+		{
+			const ShadowLight& light = shadowLights[i];
+
+			ShadowView view;
+			view.View = light.GetView();
+			view.Projection = light.GetProjection();
+			view.StaticKey = HashShadowView(view.View, view.Projection, staticBounds.GetRevision());
+
+			Frustum frustum = Frustum(view.Projection * view.View);
+
+			if (view.StaticKey != shadowKeys[i])
+			{
+				shadowKeys[i] = view.StaticKey;
+				view.HasStaticCasters = true;
+
+				staticBounds.Cull(frustum, shadowRows);
+
+				view.StaticStart = (uint32_t)packet.ShadowItems.size();
+				AddShadowItems(staticBounds, shadowRows, packet);
+				view.StaticCount = (uint32_t)packet.ShadowItems.size() - view.StaticStart;
+			}
+
+			dynamicBounds.Cull(frustum, shadowRows);
+
+			view.DynamicStart = (uint32_t)packet.ShadowItems.size();
+			AddShadowItems(dynamicBounds, shadowRows, packet);
+			view.DynamicCount = (uint32_t)packet.ShadowItems.size() - view.DynamicStart;
+
+			packet.Shadows.push_back(view);
+		}
+	}
+
+	// Registers drawables that objects created since the last frame.
+	void RegisterNewDrawables()
+	{
+		lock_guard<mutex> guard(entityArrayLock);
+
+		for (auto obj : LevelObjects)
+		{
+			for (IDrawMesh* mesh : obj->GetDrawMeshes())
+			{
+				if (mesh->boundsTable != nullptr || mesh->StaticBatched)
+					continue;
+
+				if (obj->Static)
+					staticBounds.Add(mesh, obj);
+				else
+					dynamicBounds.Add(mesh, obj);
+			}
+		}
+	}
+
 public:
 
 	static Level* Current;
 
-	vector<IDrawMesh*> VissibleRenderList = vector<IDrawMesh*>();
-
 	Level()
 	{
 
@@ -42,6 +451,12 @@ public:
 
 	static Level* OpenLevel(string filePath);
 
+	// Bakes the static geometry loaded so far into a StaticBatch object, see StaticBatch.h.
+	void BuildStaticBatch();
+
+	// Starts compiling the manifest's shader programs and the ones the level's meshes use.
+	void PrewarmShaders();
+
 	MeshUtils::PositionVerticesIndices GetStaticNavObstaclesMesh()
 	{
 		entityArrayLock.lock();
@@ -72,105 +487,164 @@ public:
 
 	}
 	
+	// Queues an object to join the current level at the next sync point, where Start is called on it.
+	// Safe from any thread, including from inside Update.
+	static void Spawn(LevelObject* entity)
+	{
+		LevelCommands::Spawn(entity);
+	}
+
+	// Queues an object to leave the level at the next sync point. It is deleted once render is done with it.
+	static void Destroy(LevelObject* entity)
+	{
+		LevelCommands::Destroy(entity);
+	}
+
+	// Sync point for Spawn and Destroy, called at the start of the simulation tick.
+	void ApplyCommands()
+	{
+		DeleteRetiredObjects(false);
+
+		pendingCommands.clear();
+		LevelCommands::Collect(pendingCommands);
+
+		// spawns first so an object spawned and destroyed in the same frame is handled
+		for (auto& command : pendingCommands)
+		{
+			if (command.CommandType != LevelCommands::Type::Spawn)
+				continue;
+
+			AddEntity(command.Object);
+			command.Object->Start();
+		}
+
+		for (auto& command : pendingCommands)
+		{
+			if (command.CommandType != LevelCommands::Type::Destroy)
+				continue;
+
+			// already destroyed, or never in this level
+			if (LevelObjects.Contains(command.Object->Handle) == false)
+				continue;
+
+			RemoveEntity(command.Object);
+			retiredObjects.push_back(RetiredObject{ command.Object, packetFrame });
+		}
+	}
+
+	// Immediate versions, for loading and for code that runs outside the tick.
 	void AddEntity(LevelObject* entity)
 	{
 		entityArrayLock.lock();
-		LevelObjects.push_back(entity);
+		entity->Handle = LevelObjects.Insert(entity);
 		entityArrayLock.unlock();
+
+		entity->OnAddedToLevel();
 	}
 
 	void RemoveEntity(LevelObject* entity)
 	{
 		entityArrayLock.lock();
-		auto it = std::find(LevelObjects.begin(), LevelObjects.end(), entity);
-		if (it != LevelObjects.end())
+		if (LevelObjects.Remove(entity->Handle))
 		{
-			LevelObjects.erase(it);
+			entity->Handle = SlotHandle();
+
+			for (IDrawMesh* mesh : entity->GetDrawMeshes())
+			{
+				if (mesh->boundsTable)
+					mesh->boundsTable->Remove(mesh);
+			}
 		}
 		entityArrayLock.unlock();
 	}
 
 
 
+	// nullptr if the object was removed since the handle was taken.
+	// Not locked, so it can be used from Update; call it from the simulation thread.
+	LevelObject* FindObject(SlotHandle handle)
+	{
+		LevelObject** object = LevelObjects.Get(handle);
+		return object ? *object : nullptr;
+	}
+
 	void UpdatePhysics()
 	{
-		entityArrayLock.lock();
 		for (auto var : LevelObjects)
 		{
 			var->UpdatePhysics();
 		}
-		entityArrayLock.unlock();
 	}
 
+	// Objects must not be added or removed directly from here, use Spawn and Destroy.
 	void Update()
 	{
-		entityArrayLock.lock();
+		PROFILE_SCOPE("Level::Update");
+
 		for (auto var : LevelObjects)
 		{
 			var->Update();
 		}
-		entityArrayLock.unlock();
 	}
 
+	// Packet of the last finished FinalizeFrame. Stays valid until the next one is published
+	// and the one after it starts building, i.e. for the whole render of the current frame.
+	const RenderPacket& GetRenderPacket() const
+	{
+		return renderPackets[publishedPacket.load(memory_order_acquire)];
+	}
+
+	// Builds the render packet for the frame. Called at the end of the simulation tick,
+	// on the same thread as Update, so it needs no lock.
 	void FinalizeFrame()
 	{
+		PROFILE_SCOPE("FinalizeFrame");
 
-		VissibleRenderList.clear();
+		RenderPacket& packet = renderPackets[1 - publishedPacket.load(memory_order_relaxed)];
 
-		vector<IDrawMesh*> opaque;
-		vector<IDrawMesh*> transparent;
+		packet.Clear();
+		packet.Frame = ++packetFrame;
 
-		entityArrayLock.lock();
-		for (auto var : LevelObjects)
-		{	
+		visibleItems.clear();
+		sortEntries.clear();
 
-			for (IDrawMesh* mesh : var->GetDrawMeshes())
-			{
-				if (mesh->IsCameraVisible())
-				{
-					if (mesh->Transparent)
-					{
-						transparent.push_back(mesh);
-					}
-					else
-					{
-						opaque.push_back(mesh);
-					}
+		RegisterNewDrawables();
 
-					var->Finalize();
+		staticBounds.RefreshAndCull(Camera::frustum);
+		dynamicBounds.RefreshAndCull(Camera::frustum);
 
-				}
-			}
+		screenSizeScale = 1.0f / tan(radians(Camera::FOV) * 0.5f);
 
-		}
+		CullDistant(staticBounds);
+		CullDistant(dynamicBounds);
 
-		entityArrayLock.unlock();
+		if (OcclusionBuffer::Enabled.load(memory_order_relaxed))
+		{
+			RasterizeOccluders();
 
+			CullOccluded(staticBounds);
+			CullOccluded(dynamicBounds);
 
-		// Sort opaque objects from closest to farthest (ascending order by distance).
-		std::sort(opaque.begin(), opaque.end(),
-			[](IDrawMesh* a, IDrawMesh* b) {
-				return a->GetDistanceToCamera() < b->GetDistanceToCamera();
-			});
+			packet.Occlusion = occlusionBuffer.Current;
+		}
 
-		// Sort transparent objects from farthest to closest (descending order by distance).
-		std::sort(transparent.begin(), transparent.end(),
-			[](IDrawMesh* a, IDrawMesh* b) {
-				return a->GetDistanceToCamera() > b->GetDistanceToCamera();
-			});
+		AddVisibleItems(staticBounds, packet);
+		AddVisibleItems(dynamicBounds, packet);
 
-		// Append sorted opaque objects first.
-		for (auto mesh : opaque)
-		{
-			VissibleRenderList.push_back(mesh);
-		}
+		BuildShadowViews(packet);
 
-		// Append sorted transparent objects second.
-		for (auto mesh : transparent)
+		RenderSort::RadixSort(sortEntries, sortScratch);
+
+		packet.Items.reserve(visibleItems.size());
+		for (const RenderSort::KeyIndex& entry : sortEntries)
 		{
-			VissibleRenderList.push_back(mesh);
+			packet.Items.push_back(visibleItems[entry.Index]);
 		}
 
+		BuildInstanceGroups(packet);
+
+		publishedPacket.store(1 - publishedPacket.load(memory_order_relaxed), memory_order_release);
+
 	}
 
 protected:
@@ -0,0 +1,53 @@
+#include "LevelCommands.h"
+
+std::mutex LevelCommands::registryLock;
+std::vector<std::unique_ptr<LevelCommands::ThreadBuffer>> LevelCommands::buffers;
+
+LevelCommands::ThreadBuffer& LevelCommands::GetThreadBuffer()
+{
+	thread_local ThreadBuffer* threadBuffer = nullptr;
+
+	if (threadBuffer == nullptr)
+	{
+		std::lock_guard<std::mutex> guard(registryLock);
+
+		buffers.push_back(std::make_unique<ThreadBuffer>());
+		threadBuffer = buffers.back().get();
+	}
+
+	return *threadBuffer;
+}
+
+void LevelCommands::Push(Type type, LevelObject* object)
+{
+	if (object == nullptr)
+		return;
+
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> guard(buffer.lock);
+	buffer.commands.push_back(Command{ type, object });
+}
+
+void LevelCommands::Spawn(LevelObject* object)
+{
+	Push(Type::Spawn, object);
+}
+
+void LevelCommands::Destroy(LevelObject* object)
+{
+	Push(Type::Destroy, object);
+}
+
+void LevelCommands::Collect(std::vector<Command>& output)
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+
+	for (auto& buffer : buffers)
+	{
+		std::lock_guard<std::mutex> bufferGuard(buffer->lock);
+
+		output.insert(output.end(), buffer->commands.begin(), buffer->commands.end());
+		buffer->commands.clear();
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class LevelObject;
+
+// Spawn and destroy requests recorded from any thread, applied by Level::ApplyCommands
+// at the start of the simulation tick. Each thread appends to its own buffer, so the
+// only lock taken per request is that buffer's, which nobody else holds outside the sync point.
+class LevelCommands
+{
+public:
+
+	enum class Type
+	{
+		Spawn,
+		Destroy
+	};
+
+	struct Command
+	{
+		Type CommandType;
+		LevelObject* Object;
+	};
+
+	static void Spawn(LevelObject* object);
+	static void Destroy(LevelObject* object);
+
+	// Moves every thread's pending commands into output. Commands of one thread keep their order.
+	static void Collect(std::vector<Command>& output);
+
+private:
+
+	struct ThreadBuffer
+	{
+		std::mutex lock;
+		std::vector<Command> commands;
+	};
+
+	// buffers live for the whole program, threads in this engine are long-lived
+	static std::mutex registryLock;
+	static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+	static ThreadBuffer& GetThreadBuffer();
+
+	static void Push(Type type, LevelObject* object);
+
+};
@@ -3,17 +3,27 @@
 #include "EObject.hpp"
 
 #include "IDrawMesh.h"
+#include "SlotMap.hpp"
 
 #include <vector>
 
 using namespace std;
 
+struct ShadowLight;
+
 class LevelObject : public EObject
 {
 public:
 
 	bool Static = false;
 
+	// Set while the object is in a level. Hold this instead of the pointer when the
+	// reference can outlive the object.
+	SlotHandle Handle;
+
+	// Frame of the last render packet this object was finalized for.
+	uint64_t FinalizedFrame = 0;
+
 	LevelObject(){}
 	~LevelObject(){}
 
@@ -22,12 +32,23 @@ public:
 
 	virtual void Start() {}
 
+	// Called after the object got its Handle.
+	virtual void OnAddedToLevel() {}
+
 	virtual void Finalize()
 	{
 
 	}
 
-	virtual vector<IDrawMesh*> GetDrawMeshes() { return vector<IDrawMesh*>(); }
+	// Fills light and returns true if the object is a shadow casting light. Asked every frame
+	// while the render packet is built.
+	virtual bool GetShadowLight(ShadowLight& light) { return false; }
+
+	virtual const vector<IDrawMesh*>& GetDrawMeshes()
+	{
+		static const vector<IDrawMesh*> empty;
+		return empty;
+	}
 
 
 private:
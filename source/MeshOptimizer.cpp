@@ -0,0 +1,454 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+
+namespace
+{
+	// Forsyth's scoring constants
+	const float CacheDecayPower = 1.5f;
+	const float LastTriangleScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	float VertexScore(int cachePosition, uint32_t liveTriangles)
+	{
+		// nothing left to draw with it
+		if (liveTriangles == 0)
+			return -1.0f;
+
+		float score = 0;
+
+		if (cachePosition >= 0)
+		{
+			// the last triangle's vertices score the same, emitting them again in a different order gains nothing
+			if (cachePosition < 3)
+				score = LastTriangleScore;
+			else
+				score = std::pow(1.0f - (float)(cachePosition - 3) / (MeshOptimizer::CacheSize - 3), CacheDecayPower);
+		}
+
+		// finish vertices with few triangles left so they don't linger
+		score += ValenceBoostScale * std::pow((float)liveTriangles, -ValenceBoostPower);
+
+		return score;
+	}
+
+	// FIFO post-transform cache by timestamps, a vertex is cached while fewer than CacheSize misses happened since its own
+	struct CacheSimulation
+	{
+		std::vector<uint32_t> timestamps;
+		uint32_t time = MeshOptimizer::CacheSize + 1;
+
+		explicit CacheSimulation(size_t vertexCount) : timestamps(vertexCount, 0) {}
+
+		void Reset()
+		{
+			time += MeshOptimizer::CacheSize + 1;
+		}
+
+		unsigned int Triangle(const uint32_t* triangle)
+		{
+			unsigned int misses = 0;
+
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t& stamp = timestamps[triangle[k]];
+
+				if (time - stamp > (uint32_t)MeshOptimizer::CacheSize)
+				{
+					stamp = time++;
+					misses++;
+				}
+			}
+
+			return misses;
+		}
+	};
+
+	struct VertexHasher
+	{
+		const std::vector<VertexData>* vertices;
+
+		size_t operator()(uint32_t index) const
+		{
+			// FNV-1a over the raw vertex, VertexData is plain floats and ints without padding
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&(*vertices)[index]);
+
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < sizeof(VertexData); i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+
+			return (size_t)hash;
+		}
+	};
+
+	struct VertexEqual
+	{
+		const std::vector<VertexData>* vertices;
+
+		bool operator()(uint32_t a, uint32_t b) const
+		{
+			return std::memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(VertexData)) == 0;
+		}
+	};
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	CacheStats stats;
+	stats.Triangles = indices.size() / 3;
+
+	std::vector<uint8_t> used(vertexCount, 0);
+	for (uint32_t index : indices)
+	{
+		stats.Vertices += used[index] == 0;
+		used[index] = 1;
+	}
+
+	CacheSimulation cache(vertexCount);
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		stats.Misses += cache.Triangle(&indices[i]);
+
+	return stats;
+}
+
+void MeshOptimizer::Optimize(std::vector<VertexData>& vertices, std::vector<uint32_t>& indices)
+{
+	if (indices.size() < 3 || vertices.empty())
+		return;
+
+	WeldVertices(vertices, indices);
+	OptimizeVertexCache(indices, vertices.size());
+	OptimizeOverdraw(indices, vertices);
+	OptimizeVertexFetch(vertices, indices);
+}
+
+void MeshOptimizer::WeldVertices(std::vector<VertexData>& vertices, std::vector<uint32_t>& indices)
+{
+	size_t vertexCount = vertices.size();
+
+	std::unordered_set<uint32_t, VertexHasher, VertexEqual> unique(vertexCount, VertexHasher{ &vertices }, VertexEqual{ &vertices });
+
+	// first copy of every vertex keeps its place
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<VertexData> welded;
+	welded.reserve(vertexCount);
+
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		auto inserted = unique.insert(v);
+
+		if (inserted.second)
+		{
+			remap[v] = (uint32_t)welded.size();
+			welded.push_back(vertices[v]);
+		}
+		else
+		{
+			remap[v] = remap[*inserted.first];
+		}
+	}
+
+	if (welded.size() == vertexCount)
+		return;
+
+	for (uint32_t& index : indices)
+		index = remap[index];
+
+	vertices = std::move(welded);
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+
+	if (triangleCount == 0)
+		return;
+
+	// triangles around every vertex, the first liveTriangles[v] entries are the ones not emitted yet
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		liveTriangles[indices[i]]++;
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[cursor[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = VertexScore(-1, liveTriangles[v]);
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<uint8_t> emitted(triangleCount, 0);
+
+	int64_t best = -1;
+	float bestScore = -FLT_MAX;
+
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+		if (triangleScores[t] > bestScore)
+		{
+			bestScore = triangleScores[t];
+			best = (int64_t)t;
+		}
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+
+	// three extra slots for the vertices the new triangle pushes in
+	uint32_t cache[CacheSize + 3];
+	uint32_t newCache[CacheSize + 3];
+	int cacheCount = 0;
+
+	size_t inputCursor = 0;
+
+	while (result.size() < triangleCount * 3)
+	{
+		// nothing in the cache has triangles left, continue in input order
+		if (best < 0)
+		{
+			while (emitted[inputCursor])
+				inputCursor++;
+
+			best = (int64_t)inputCursor;
+		}
+
+		const uint32_t* triangle = &indices[(size_t)best * 3];
+
+		emitted[best] = 1;
+		result.insert(result.end(), triangle, triangle + 3);
+
+		int newCount = 0;
+
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = triangle[k];
+
+			// drop the triangle from the vertex's live list
+			uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+			uint32_t* end = begin + liveTriangles[v];
+			uint32_t* found = std::find(begin, end, (uint32_t)best);
+
+			if (found != end)
+			{
+				*found = *(end - 1);
+				*(end - 1) = (uint32_t)best;
+				liveTriangles[v]--;
+			}
+
+			if (std::find(newCache, newCache + newCount, v) == newCache + newCount)
+				newCache[newCount++] = v;
+		}
+
+		for (int i = 0; i < cacheCount; i++)
+		{
+			uint32_t v = cache[i];
+
+			if (std::find(newCache, newCache + newCount, v) == newCache + newCount)
+				newCache[newCount++] = v;
+		}
+
+		best = -1;
+		bestScore = -FLT_MAX;
+
+		// rescore everything that moved in the cache, including what just fell out of it
+		for (int i = 0; i < newCount; i++)
+		{
+			uint32_t v = newCache[i];
+
+			cachePosition[v] = i < CacheSize ? i : -1;
+
+			float score = VertexScore(cachePosition[v], liveTriangles[v]);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + liveTriangles[v]; a++)
+			{
+				uint32_t t = adjacency[a];
+
+				triangleScores[t] += delta;
+
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					best = (int64_t)t;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCount, (int)CacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+	}
+
+	std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<VertexData>& vertices, float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+
+	if (triangleCount < 2)
+		return;
+
+	CacheSimulation cache(vertices.size());
+
+	// a triangle missing all its vertices is where the cache order jumped, moving the run after it costs nothing
+	std::vector<uint32_t> hardBoundaries;
+
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (cache.Triangle(&indices[t * 3]) == 3)
+			hardBoundaries.push_back((uint32_t)t);
+	}
+
+	hardBoundaries.push_back((uint32_t)triangleCount);
+
+	// split the runs further wherever the cluster so far is already about as cache friendly as the whole run
+	std::vector<uint32_t> clusters;
+
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+	{
+		uint32_t start = hardBoundaries[h];
+		uint32_t end = hardBoundaries[h + 1];
+
+		cache.Reset();
+
+		unsigned int runMisses = 0;
+		for (uint32_t t = start; t < end; t++)
+			runMisses += cache.Triangle(&indices[t * 3]);
+
+		float runAcmr = (float)runMisses / (end - start);
+
+		cache.Reset();
+
+		clusters.push_back(start);
+
+		uint32_t clusterStart = start;
+		unsigned int clusterMisses = 0;
+
+		for (uint32_t t = start; t < end; t++)
+		{
+			clusterMisses += cache.Triangle(&indices[t * 3]);
+
+			if (t + 1 < end && (float)clusterMisses / (t + 1 - clusterStart) <= runAcmr * threshold)
+			{
+				clusters.push_back(t + 1);
+
+				clusterStart = t + 1;
+				clusterMisses = 0;
+
+				cache.Reset();
+			}
+		}
+	}
+
+	if (clusters.size() < 2)
+		return;
+
+	clusters.push_back((uint32_t)triangleCount);
+
+	size_t clusterCount = clusters.size() - 1;
+
+	// area weighted centroid and normal of the mesh and of every cluster
+	std::vector<vec3> clusterCentroids(clusterCount, vec3(0));
+	std::vector<vec3> clusterNormals(clusterCount, vec3(0));
+
+	vec3 meshCentroid = vec3(0);
+	float meshArea = 0;
+
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float clusterArea = 0;
+
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const vec3& p0 = vertices[indices[t * 3]].Position;
+			const vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+			const vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+
+			vec3 normal = cross(p1 - p0, p2 - p0);
+			float area = length(normal);
+
+			vec3 centroid = (p0 + p1 + p2) * (area / 3.0f);
+
+			clusterCentroids[c] += centroid;
+			clusterNormals[c] += normal;
+			clusterArea += area;
+
+			meshCentroid += centroid;
+			meshArea += area;
+		}
+
+		if (clusterArea > 0)
+			clusterCentroids[c] /= clusterArea;
+	}
+
+	if (meshArea > 0)
+		meshCentroid /= meshArea;
+
+	// clusters facing outwards far from the center are likely to cover the rest, draw them first
+	std::vector<float> sortKeys(clusterCount);
+	std::vector<uint32_t> order(clusterCount);
+
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float normalLength = length(clusterNormals[c]);
+		vec3 normal = normalLength > 0 ? clusterNormals[c] / normalLength : vec3(0);
+
+		sortKeys[c] = dot(clusterCentroids[c] - meshCentroid, normal);
+		order[c] = (uint32_t)c;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+
+	for (uint32_t c : order)
+		result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+
+	std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<VertexData>& vertices, std::vector<uint32_t>& indices)
+{
+	const uint32_t Unused = ~0u;
+
+	std::vector<uint32_t> remap(vertices.size(), Unused);
+	std::vector<VertexData> ordered;
+	ordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == Unused)
+		{
+			remap[index] = (uint32_t)ordered.size();
+			ordered.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices = std::move(ordered);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm.h"
+#include "VertexData.h"
+
+// Reorders triangle lists for the GPU after import: identical vertices are welded, triangles
+// are ordered for the post-transform vertex cache (Forsyth's linear-speed algorithm), groups
+// of them are sorted front to back from the outside to cut overdraw (Tipsify style clusters),
+// and finally vertices are renumbered in the order the triangles first use them so vertex
+// fetch walks the buffer forwards. None of it changes what is drawn.
+class MeshOptimizer
+{
+public:
+
+	// post-transform cache the orderings and statistics assume
+	static const int CacheSize = 16;
+
+	// FIFO cache simulation of an index buffer
+	struct CacheStats
+	{
+		uint64_t Triangles = 0;
+		uint64_t Vertices = 0;
+		uint64_t Misses = 0;
+
+		// average cache misses per triangle, 0.5 is the ideal for large grids, 3 the worst
+		float GetACMR() const { return Triangles ? (float)Misses / Triangles : 0.0f; }
+
+		// average transforms per vertex, 1 is ideal
+		float GetATVR() const { return Vertices ? (float)Misses / Vertices : 0.0f; }
+
+		void Add(const CacheStats& other)
+		{
+			Triangles += other.Triangles;
+			Vertices += other.Vertices;
+			Misses += other.Misses;
+		}
+	};
+
+	static CacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Runs every step below on the mesh in place.
+	static void Optimize(std::vector<VertexData>& vertices, std::vector<uint32_t>& indices);
+
+	// Merges bitwise identical vertices.
+	static void WeldVertices(std::vector<VertexData>& vertices, std::vector<uint32_t>& indices);
+
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Expects cache optimized indices and keeps the cache order inside the clusters it moves.
+	// A cluster is only split off where the cache would not lose more than threshold times
+	// its miss rate.
+	static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<VertexData>& vertices, float threshold = 1.05f);
+
+	// Renumbers vertices by first use and drops unreferenced ones.
+	static void OptimizeVertexFetch(std::vector<VertexData>& vertices, std::vector<uint32_t>& indices);
+
+};
@@ -0,0 +1,310 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace
+{
+	// symmetric 4x4 matrix of the summed plane equations
+	struct Quadric
+	{
+		double A2 = 0, AB = 0, AC = 0, AD = 0;
+		double B2 = 0, BC = 0, BD = 0;
+		double C2 = 0, CD = 0;
+		double D2 = 0;
+
+		// summed plane weights, Evaluate divides by it
+		double Weight = 0;
+
+		void AddPlane(double a, double b, double c, double d, double weight)
+		{
+			Weight += weight;
+			A2 += a * a * weight; AB += a * b * weight; AC += a * c * weight; AD += a * d * weight;
+			B2 += b * b * weight; BC += b * c * weight; BD += b * d * weight;
+			C2 += c * c * weight; CD += c * d * weight;
+			D2 += d * d * weight;
+		}
+
+		void Add(const Quadric& other)
+		{
+			A2 += other.A2; AB += other.AB; AC += other.AC; AD += other.AD;
+			B2 += other.B2; BC += other.BC; BD += other.BD;
+			C2 += other.C2; CD += other.CD;
+			D2 += other.D2;
+			Weight += other.Weight;
+		}
+
+		// weighted mean of the squared distances of p to the planes, so in position units squared
+		double Evaluate(const vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+
+			double error =
+				x * x * A2 + 2 * x * y * AB + 2 * x * z * AC + 2 * x * AD +
+				y * y * B2 + 2 * y * z * BC + 2 * y * BD +
+				z * z * C2 + 2 * z * CD +
+				D2;
+
+			if (error <= 0 || Weight <= 0)
+				return 0;
+
+			return error / Weight;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t From;
+		uint32_t To;
+		double Cost;
+	};
+
+	uint64_t EdgeKey(uint32_t a, uint32_t b)
+	{
+		if (a > b)
+			std::swap(a, b);
+
+		return ((uint64_t)a << 32) | b;
+	}
+}
+
+std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<vec3>& positions, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, float* error)
+{
+	std::vector<uint32_t> result = indices;
+
+	if (error)
+		*error = 0;
+
+	if (result.size() <= targetIndexCount || positions.empty())
+		return result;
+
+	size_t vertexCount = positions.size();
+
+	// one id per distinct position, quadrics and topology work on these
+	std::vector<uint32_t> positionId(vertexCount);
+	std::vector<uint32_t> positionVertices;
+
+	{
+		std::unordered_map<vec3, uint32_t> ids;
+		ids.reserve(vertexCount);
+
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			auto inserted = ids.emplace(positions[v], (uint32_t)ids.size());
+			positionId[v] = inserted.first->second;
+
+			if (inserted.second)
+				positionVertices.push_back(0);
+
+			positionVertices[positionId[v]]++;
+		}
+	}
+
+	size_t idCount = positionVertices.size();
+
+	// seams: more than one vertex at the position
+	std::vector<uint8_t> locked(idCount, 0);
+	for (size_t id = 0; id < idCount; id++)
+		locked[id] = positionVertices[id] > 1;
+
+	// borders: edges with a single triangle
+	{
+		std::unordered_map<uint64_t, uint32_t> edgeTriangles;
+		edgeTriangles.reserve(result.size());
+
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+				edgeTriangles[EdgeKey(positionId[result[i + e]], positionId[result[i + (e + 1) % 3]])]++;
+		}
+
+		for (const auto& edge : edgeTriangles)
+		{
+			if (edge.second == 1)
+			{
+				locked[edge.first >> 32] = 1;
+				locked[edge.first & 0xFFFFFFFF] = 1;
+			}
+		}
+	}
+
+	std::vector<Quadric> quadrics(idCount);
+
+	for (size_t i = 0; i + 2 < result.size(); i += 3)
+	{
+		const vec3& p0 = positions[result[i]];
+		const vec3& p1 = positions[result[i + 1]];
+		const vec3& p2 = positions[result[i + 2]];
+
+		dvec3 normal = cross(dvec3(p1) - dvec3(p0), dvec3(p2) - dvec3(p0));
+		double doubleArea = length(normal);
+
+		if (doubleArea <= 0)
+			continue;
+
+		normal /= doubleArea;
+		double distance = -dot(normal, dvec3(p0));
+
+		// area weighted, so big flat regions resist being pulled
+		for (int k = 0; k < 3; k++)
+			quadrics[positionId[result[i + k]]].AddPlane(normal.x, normal.y, normal.z, distance, doubleArea * 0.5);
+	}
+
+	double maxCost = (double)maxError * maxError;
+	double largestCost = 0;
+
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> touched(idCount);
+
+	std::vector<uint32_t> adjacencyOffsets(idCount + 1);
+	std::vector<uint32_t> adjacency;
+
+	std::vector<Collapse> candidates;
+
+	while (result.size() > targetIndexCount)
+	{
+		size_t triangleCount = result.size() / 3;
+
+		// triangles around every position
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (uint32_t index : result)
+			adjacencyOffsets[positionId[index] + 1]++;
+
+		for (size_t id = 0; id < idCount; id++)
+			adjacencyOffsets[id + 1] += adjacencyOffsets[id];
+
+		adjacency.resize(result.size());
+		{
+			std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				for (int k = 0; k < 3; k++)
+					adjacency[cursor[positionId[result[t * 3 + k]]]++] = (uint32_t)t;
+			}
+		}
+
+		candidates.clear();
+
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				uint32_t a = result[t * 3 + e];
+				uint32_t b = result[t * 3 + (e + 1) % 3];
+
+				uint32_t idA = positionId[a];
+				uint32_t idB = positionId[b];
+
+				Quadric combined = quadrics[idA];
+				combined.Add(quadrics[idB]);
+
+				if (locked[idA] == 0)
+					candidates.push_back({ a, b, combined.Evaluate(positions[b]) });
+
+				if (locked[idB] == 0)
+					candidates.push_back({ b, a, combined.Evaluate(positions[a]) });
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) { return x.Cost < y.Cost; });
+
+		// a collapse removes about two triangles
+		size_t wanted = (result.size() - targetIndexCount) / 6 + 1;
+		size_t collapses = 0;
+
+		std::fill(touched.begin(), touched.end(), 0);
+
+		for (size_t v = 0; v < vertexCount; v++)
+			remap[v] = (uint32_t)v;
+
+		for (const Collapse& collapse : candidates)
+		{
+			if (collapses >= wanted || collapse.Cost > maxCost)
+				break;
+
+			uint32_t from = positionId[collapse.From];
+			uint32_t to = positionId[collapse.To];
+
+			if (touched[from] || touched[to])
+				continue;
+
+			// moving from onto to must not turn any remaining triangle around
+			const vec3& target = positions[collapse.To];
+			bool flips = false;
+
+			for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && flips == false; a++)
+			{
+				const uint32_t* triangle = &result[adjacency[a] * 3];
+
+				vec3 corners[3];
+				bool hasTo = false;
+
+				for (int k = 0; k < 3; k++)
+				{
+					corners[k] = positions[triangle[k]];
+					hasTo |= positionId[triangle[k]] == to;
+				}
+
+				// collapses into a line and goes away
+				if (hasTo)
+					continue;
+
+				vec3 before = cross(corners[1] - corners[0], corners[2] - corners[0]);
+
+				for (int k = 0; k < 3; k++)
+				{
+					if (positionId[triangle[k]] == from)
+						corners[k] = target;
+				}
+
+				vec3 after = cross(corners[1] - corners[0], corners[2] - corners[0]);
+
+				flips = dot(before, after) <= 0;
+			}
+
+			if (flips)
+				continue;
+
+			remap[collapse.From] = collapse.To;
+			quadrics[to].Add(quadrics[from]);
+
+			// neighbours were checked against the current positions, keep them still this pass
+			for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++)
+			{
+				for (int k = 0; k < 3; k++)
+					touched[positionId[result[adjacency[a] * 3 + k]]] = 1;
+			}
+
+			largestCost = std::max(largestCost, collapse.Cost);
+			collapses++;
+		}
+
+		if (collapses == 0)
+			break;
+
+		size_t kept = 0;
+
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t a = remap[result[t * 3]];
+			uint32_t b = remap[result[t * 3 + 1]];
+			uint32_t c = remap[result[t * 3 + 2]];
+
+			if (positionId[a] == positionId[b] || positionId[b] == positionId[c] || positionId[a] == positionId[c])
+				continue;
+
+			result[kept++] = a;
+			result[kept++] = b;
+			result[kept++] = c;
+		}
+
+		result.resize(kept);
+	}
+
+	if (error)
+		*error = (float)std::sqrt(largestCost);
+
+	return result;
+}
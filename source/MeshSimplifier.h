@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm.h"
+
+// Quadric error metric simplification (Garland and Heckbert) by half edge collapses. A vertex
+// is only ever merged into another existing vertex, so the result is a new index buffer over
+// the same vertices and all LODs of a mesh can share one vertex buffer.
+//
+// Vertices on open borders and on attribute seams (several vertices at one position) never
+// move, which keeps silhouettes and texture seams intact at the cost of some reduction.
+class MeshSimplifier
+{
+public:
+
+	// Collapses edges of the triangle list until at most targetIndexCount indices remain or no
+	// collapse with an error below maxError is left. The error of a collapse is the root of the
+	// area weighted mean squared distance from the moved vertex to the planes of its merged
+	// triangles, in position units. error receives the largest error of the collapses that were made.
+	static std::vector<uint32_t> Simplify(const std::vector<vec3>& positions, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, float* error = nullptr);
+
+};
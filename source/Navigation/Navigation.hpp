@@ -7,12 +7,17 @@
 #include "Detour/DetourTileCacheBuilder.h"
 
 #include <mutex>
+#include <vector>
 
 #include "../Time.hpp"
 
+#include "../Profiler.h"
+
 #include "../DebugDraw.hpp"
 #include "Detour/DetourNavMeshQuery.h"
 
+using namespace std;
+
 
 class NavigationSystem
 {
@@ -32,7 +37,8 @@ public:
 
     static void Update()
     {
-        
+        PROFILE_SCOPE("NavigationSystem::Update");
+
         std::lock_guard<std::mutex> lock(mainLock);
 
         bool upToDate = false;
@@ -50,7 +56,7 @@ public:
 
     static void GenerateNavData();
 
-    // DrawNavmesh renders every edge in the navigation mesh using DebugDraw::Line.
+    // DrawNavmesh renders every edge in the navigation mesh as DebugDraw lines, appended in one batch.
 // It uses the dtNavMesh's internal tile storage to iterate over all polygons.
     static void DrawNavmesh()
     {
@@ -59,6 +65,8 @@ public:
 
         std::lock_guard<std::mutex> lock(mainLock);
 
+        std::vector<glm::vec3> edges;
+
         const int maxTiles = navMesh->getMaxTiles();
         for (int i = 0; i < maxTiles; ++i)
         {
@@ -94,10 +102,13 @@ public:
                     if (glm::distance(p0, p1) < 0.001f)
                         continue;
 
-                    DebugDraw::Line(p0, p1, 0.2f, Time::DeltaTimeF/2); // longer duration for better visibility
+                    edges.push_back(p0);
+                    edges.push_back(p1);
                 }
             }
         }
+
+        DebugDraw::Lines(edges, 0.2f, Time::DeltaTimeF/2); // longer duration for better visibility
     }
 
     static void RemoveObstacle(dtObstacleRef obstacleRef)
@@ -0,0 +1,318 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "SimdMath.hpp"
+#include "JobScheduler.h"
+
+std::atomic<bool> OcclusionBuffer::Enabled = true;
+
+// rows per rasterization job, a multiple of Block so each job also owns its tiles
+static const int BandHeight = OcclusionBuffer::Block * 2;
+
+// keeps coplanar occludees (the occluders themselves, decals on walls) visible
+static const float DepthBias = 0.0005f;
+
+void OcclusionBuffer::Begin(const mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+
+	occluderVertices.clear();
+
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(blockMaxDepth.begin(), blockMaxDepth.end(), 1.0f);
+
+	Current = Stats();
+}
+
+void OcclusionBuffer::AddOccluder(const std::vector<vec3>& triangles)
+{
+	occluderVertices.insert(occluderVertices.end(), triangles.begin(), triangles.end());
+}
+
+bool OcclusionBuffer::SetupScreenTriangle(const vec4& a, const vec4& b, const vec4& c, ScreenTriangle& triangle) const
+{
+	vec3 p[3];
+
+	const vec4* clip[3] = { &a, &b, &c };
+	for (int i = 0; i < 3; i++)
+	{
+		const vec4& v = *clip[i];
+		float invW = 1.0f / v.w;
+
+		p[i].x = (v.x * invW * 0.5f + 0.5f) * Width;
+		p[i].y = (v.y * invW * 0.5f + 0.5f) * Height;
+		p[i].z = v.z * invW * 0.5f + 0.5f;
+	}
+
+	float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+
+	if (std::abs(area) < 1e-6f)
+		return false;
+
+	// occluders are two sided, make the winding counter clockwise so insides are positive
+	if (area < 0)
+	{
+		std::swap(p[1], p[2]);
+		area = -area;
+	}
+
+	vec3 minP = min(min(p[0], p[1]), p[2]);
+	vec3 maxP = max(max(p[0], p[1]), p[2]);
+
+	float minX = std::max(floor(minP.x), 0.0f);
+	float maxX = std::min(ceil(maxP.x), (float)(Width - 1));
+	float minY = std::max(floor(minP.y), 0.0f);
+	float maxY = std::min(ceil(maxP.y), (float)(Height - 1));
+
+	if (minX > maxX || minY > maxY)
+		return false;
+
+	// 4 pixels at a time, rows are a multiple of 4 wide
+	triangle.MinX = (int)minX & ~3;
+	triangle.MaxX = (int)maxX;
+	triangle.MinY = (int)minY;
+	triangle.MaxY = (int)maxY;
+
+	for (int i = 0; i < 3; i++)
+	{
+		const vec3& from = p[i];
+		const vec3& to = p[(i + 1) % 3];
+
+		triangle.EdgeA[i] = from.y - to.y;
+		triangle.EdgeB[i] = to.x - from.x;
+		triangle.EdgeC[i] = -(triangle.EdgeA[i] * from.x + triangle.EdgeB[i] * from.y);
+	}
+
+	// z/w is linear in screen space
+	float dz1 = p[1].z - p[0].z;
+	float dz2 = p[2].z - p[0].z;
+
+	triangle.DepthA = (dz1 * (p[2].y - p[0].y) - dz2 * (p[1].y - p[0].y)) / area;
+	triangle.DepthB = (dz2 * (p[1].x - p[0].x) - dz1 * (p[2].x - p[0].x)) / area;
+	triangle.DepthC = p[0].z - triangle.DepthA * p[0].x - triangle.DepthB * p[0].y;
+
+	return true;
+}
+
+void OcclusionBuffer::SetupTriangle(uint32_t index)
+{
+	triangleValid[index * 2] = 0;
+	triangleValid[index * 2 + 1] = 0;
+
+	vec4 clip[3];
+	for (int i = 0; i < 3; i++)
+		clip[i] = viewProjection * vec4(occluderVertices[index * 3 + i], 1.0f);
+
+	// all vertices outside the same side plane
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w)
+			return;
+
+		if (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w)
+			return;
+	}
+
+	// clip against the near plane (z >= -w), which leaves 0, 3 or 4 vertices
+	vec4 polygon[4];
+	int vertexCount = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		const vec4& current = clip[i];
+		const vec4& next = clip[(i + 1) % 3];
+
+		float currentDistance = current.z + current.w;
+		float nextDistance = next.z + next.w;
+
+		if (currentDistance >= 0)
+			polygon[vertexCount++] = current;
+
+		if ((currentDistance >= 0) != (nextDistance >= 0))
+		{
+			float t = currentDistance / (currentDistance - nextDistance);
+			polygon[vertexCount++] = mix(current, next, t);
+		}
+	}
+
+	if (vertexCount < 3)
+		return;
+
+	triangleValid[index * 2] = SetupScreenTriangle(polygon[0], polygon[1], polygon[2], triangles[index * 2]);
+
+	if (vertexCount == 4)
+		triangleValid[index * 2 + 1] = SetupScreenTriangle(polygon[0], polygon[2], polygon[3], triangles[index * 2 + 1]);
+}
+
+void OcclusionBuffer::RasterizeBand(int minY, int maxY)
+{
+	static const float laneOffsets[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+	const simd::float4 lanes = simd::Load(laneOffsets);
+	const simd::float4 zero = simd::Splat(0.0f);
+
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		if (triangleValid[t] == 0)
+			continue;
+
+		const ScreenTriangle& triangle = triangles[t];
+
+		int y0 = std::max(minY, triangle.MinY);
+		int y1 = std::min(maxY - 1, triangle.MaxY);
+
+		if (y0 > y1)
+			continue;
+
+		simd::float4 edgeA0 = simd::Splat(triangle.EdgeA[0]);
+		simd::float4 edgeA1 = simd::Splat(triangle.EdgeA[1]);
+		simd::float4 edgeA2 = simd::Splat(triangle.EdgeA[2]);
+		simd::float4 depthA = simd::Splat(triangle.DepthA);
+
+		for (int y = y0; y <= y1; y++)
+		{
+			float pixelY = y + 0.5f;
+
+			simd::float4 rowEdge0 = simd::Splat(triangle.EdgeB[0] * pixelY + triangle.EdgeC[0]);
+			simd::float4 rowEdge1 = simd::Splat(triangle.EdgeB[1] * pixelY + triangle.EdgeC[1]);
+			simd::float4 rowEdge2 = simd::Splat(triangle.EdgeB[2] * pixelY + triangle.EdgeC[2]);
+			simd::float4 rowDepth = simd::Splat(triangle.DepthB * pixelY + triangle.DepthC);
+
+			float* row = depth.data() + y * Width;
+
+			for (int x = triangle.MinX; x <= triangle.MaxX; x += 4)
+			{
+				simd::float4 pixelX = simd::Add(simd::Splat((float)x), lanes);
+
+				simd::float4 edge0 = simd::MulAdd(edgeA0, pixelX, rowEdge0);
+				simd::float4 edge1 = simd::MulAdd(edgeA1, pixelX, rowEdge1);
+				simd::float4 edge2 = simd::MulAdd(edgeA2, pixelX, rowEdge2);
+
+				simd::float4 outside = simd::Or(simd::Or(simd::Less(edge0, zero), simd::Less(edge1, zero)), simd::Less(edge2, zero));
+
+				if (simd::MoveMask(outside) == 0xF)
+					continue;
+
+				simd::float4 pixelDepth = simd::MulAdd(depthA, pixelX, rowDepth);
+				simd::float4 previous = simd::Load(row + x);
+
+				simd::Store(row + x, simd::Select(outside, previous, simd::Min(previous, pixelDepth)));
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::BuildBlocks(int blockY)
+{
+	for (int blockX = 0; blockX < BlocksX; blockX++)
+	{
+		simd::float4 farthest = simd::Splat(0.0f);
+
+		for (int y = 0; y < Block; y++)
+		{
+			const float* row = depth.data() + (blockY * Block + y) * Width + blockX * Block;
+
+			for (int x = 0; x < Block; x += 4)
+				farthest = simd::Max(farthest, simd::Load(row + x));
+		}
+
+		float lanes[4];
+		simd::Store(lanes, farthest);
+
+		blockMaxDepth[blockY * BlocksX + blockX] = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+	}
+}
+
+void OcclusionBuffer::Rasterize()
+{
+	uint32_t count = GetTriangleCount();
+	Current.OccluderTriangles = count;
+
+	triangles.resize(count * 2);
+	triangleValid.resize(count * 2);
+
+	JobScheduler::ParallelFor(count, 256, [this](uint32_t start, uint32_t end)
+		{
+			for (uint32_t i = start; i < end; i++)
+				SetupTriangle(i);
+		});
+
+	// bands own disjoint rows and tiles, so they need no synchronisation
+	const uint32_t bandCount = Height / BandHeight;
+
+	JobScheduler::ParallelFor(bandCount, 1, [this](uint32_t start, uint32_t end)
+		{
+			for (uint32_t band = start; band < end; band++)
+			{
+				RasterizeBand(band * BandHeight, (band + 1) * BandHeight);
+
+				for (int blockY = band * BandHeight / Block; blockY < (int)(band + 1) * BandHeight / Block; blockY++)
+					BuildBlocks(blockY);
+			}
+		});
+}
+
+bool OcclusionBuffer::IsBoxVisible(const vec3& min, const vec3& max) const
+{
+	vec2 screenMin = vec2(FLT_MAX);
+	vec2 screenMax = vec2(-FLT_MAX);
+	float nearest = FLT_MAX;
+
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+		vec4 clip = viewProjection * vec4(corner, 1.0f);
+
+		// crosses the near plane, the camera is at or inside the box
+		if (clip.z < -clip.w)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		vec2 screen = vec2((clip.x * invW * 0.5f + 0.5f) * Width, (clip.y * invW * 0.5f + 0.5f) * Height);
+
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+		nearest = std::min(nearest, clip.z * invW * 0.5f + 0.5f);
+	}
+
+	nearest -= DepthBias;
+
+	int x0 = std::max((int)floor(screenMin.x), 0);
+	int x1 = std::min((int)ceil(screenMax.x), Width - 1);
+	int y0 = std::max((int)floor(screenMin.y), 0);
+	int y1 = std::min((int)ceil(screenMax.y), Height - 1);
+
+	// frustum culling already let it through, be conservative about what the buffer does not cover
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	for (int blockY = y0 / Block; blockY <= y1 / Block; blockY++)
+	{
+		for (int blockX = x0 / Block; blockX <= x1 / Block; blockX++)
+		{
+			if (blockMaxDepth[blockY * BlocksX + blockX] < nearest)
+				continue;
+
+			// the tile has something behind the box somewhere, check the pixels the box covers
+			int pixelY0 = std::max(y0, blockY * Block);
+			int pixelY1 = std::min(y1, blockY * Block + Block - 1);
+			int pixelX0 = std::max(x0, blockX * Block);
+			int pixelX1 = std::min(x1, blockX * Block + Block - 1);
+
+			for (int y = pixelY0; y <= pixelY1; y++)
+			{
+				const float* row = depth.data() + y * Width;
+
+				for (int x = pixelX0; x <= pixelX1; x++)
+				{
+					if (row[x] >= nearest)
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
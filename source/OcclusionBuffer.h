@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "glm.h"
+
+// Small CPU depth buffer for occlusion culling. Occluder triangles (world space, 3 vertices
+// each) are rasterized into it with 4-wide SIMD, the screen split into horizontal bands that
+// run on the job scheduler's workers. Every Block x Block tile then keeps its farthest depth,
+// so most box tests are answered by a few tiles and only the remaining ones touch pixels.
+//
+// Depth is z/w remapped to [0, 1], smaller is nearer, the buffer keeps the nearest value.
+// Nothing here touches GL, the whole thing runs on the simulation thread and its workers.
+class OcclusionBuffer
+{
+public:
+
+	static const int Width = 256;
+	static const int Height = 128;
+
+	static const int Block = 8;
+	static const int BlocksX = Width / Block;
+	static const int BlocksY = Height / Block;
+
+	struct Stats
+	{
+		uint32_t OccluderTriangles = 0;
+		uint32_t Tested = 0;
+		uint32_t Culled = 0;
+	};
+
+	// set from the render settings on the main thread, read by the next FinalizeFrame
+	static std::atomic<bool> Enabled;
+
+	Stats Current;
+
+	// Clears the buffer and the occluder list.
+	void Begin(const mat4& viewProjection);
+
+	// Queues world space triangles, 3 vertices per triangle.
+	void AddOccluder(const std::vector<vec3>& triangles);
+
+	uint32_t GetTriangleCount() const { return (uint32_t)(occluderVertices.size() / 3); }
+
+	// Rasterizes the queued occluders and builds the tile depths. Blocks until done.
+	void Rasterize();
+
+	// Whether any part of the box could be in front of the occluders. Boxes that cross the
+	// near plane or leave the screen are always visible. Safe to call from several threads.
+	bool IsBoxVisible(const vec3& min, const vec3& max) const;
+
+	const float* GetDepth() const { return depth.data(); }
+
+private:
+
+	// clip space triangle reduced to screen space edge and depth planes
+	struct ScreenTriangle
+	{
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+
+		float DepthA;
+		float DepthB;
+		float DepthC;
+
+		int MinX, MaxX;
+		int MinY, MaxY;
+	};
+
+	mat4 viewProjection = mat4(1.0f);
+
+	std::vector<vec3> occluderVertices;
+
+	// two slots per occluder triangle, near plane clipping can split one
+	std::vector<ScreenTriangle> triangles;
+	std::vector<uint8_t> triangleValid;
+
+	std::vector<float> depth = std::vector<float>(Width * Height, 1.0f);
+	std::vector<float> blockMaxDepth = std::vector<float>(BlocksX * BlocksY, 1.0f);
+
+	void SetupTriangle(uint32_t index);
+	bool SetupScreenTriangle(const vec4& a, const vec4& b, const vec4& c, ScreenTriangle& triangle) const;
+
+	void RasterizeBand(int minY, int maxY);
+	void BuildBlocks(int blockY);
+
+};
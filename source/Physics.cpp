@@ -1,5 +1,8 @@
 #include "Physics.h"
 
+#include "Level.hpp"
+#include "Entity.hpp"
+
 TempAllocatorImpl* Physics::tempMemAllocator = nullptr;
 
 JobSystemThreadPool* Physics::threadPool = nullptr;
@@ -16,5 +19,41 @@ MyContactListener* Physics::contact_listener = nullptr;
 
 BodyInterface* Physics::bodyInterface = nullptr;
 
-vector<Body*> Physics::existingBodies = vector<Body*>();
-mutex Physics::physicsMainLock = mutex();
\ No newline at end of file
+SlotMap<Body*> Physics::existingBodies;
+
+double Physics::accumulator = 0;
+
+float Physics::FixedTimeStep = 1.0f / 60.0f;
+int Physics::MaxSubSteps = 4;
+int Physics::CollisionSteps = 1;
+float Physics::InterpolationAlpha = 0;
+int Physics::StepsThisFrame = 0;
+mutex Physics::physicsMainLock = mutex();
+
+Entity* Physics::GetBodyOwner(const Body* body)
+{
+	if (body == nullptr || Level::Current == nullptr)
+		return nullptr;
+
+	auto* props = reinterpret_cast<BodyData*>(body->GetUserData());
+	if (props == nullptr)
+		return nullptr;
+
+	// resolved through the handle so a destroyed owner is never dereferenced
+	return dynamic_cast<Entity*>(Level::Current->FindObject(props->OwnerHandle));
+}
+
+SlotHandle Physics::GetOwnerHandle(Entity* owner)
+{
+	return owner ? owner->Handle : SlotHandle();
+}
+
+void Physics::UpdateOwnerHandle(Body* body, Entity* owner)
+{
+	if (body == nullptr)
+		return;
+
+	auto* props = reinterpret_cast<BodyData*>(body->GetUserData());
+	if (props)
+		props->OwnerHandle = GetOwnerHandle(owner);
+}
@@ -42,6 +42,10 @@
 
 #include "MathHelper.hpp"
 
+#include "SlotMap.hpp"
+
+#include "Profiler.h"
+
 using namespace JPH;
 
 using namespace std;
@@ -102,6 +106,17 @@ struct BodyData
 
 	Entity* OwnerEntity;
 
+	// slot of the body in Physics' body list
+	SlotHandle Handle;
+
+	// level handle of OwnerEntity, lets Physics::GetBodyOwner detect an owner that was removed
+	SlotHandle OwnerHandle;
+
+	// transform before the last fixed step, for render interpolation
+	JPH::RVec3 PreviousPosition = JPH::RVec3::sZero();
+	JPH::Quat PreviousRotation = JPH::Quat::sIdentity();
+	bool HasPrevious = false;
+
 };
 
 // Layer that objects can be in, determines which other objects it can collide with
@@ -310,17 +325,57 @@ private:
 
 	static BodyInterface* bodyInterface;
 
-	static vector<Body*> existingBodies;
+	static SlotMap<Body*> existingBodies;
 
 	static mutex physicsMainLock;
 
+	static double accumulator;
+
+	// Stores every moving body's transform so it can be blended with the result of the next step.
+	static void CapturePreviousTransforms()
+	{
+		for (Body* body : existingBodies)
+		{
+			if (body->IsStatic())
+				continue;
+
+			auto* props = reinterpret_cast<BodyData*>(body->GetUserData());
+			if (props == nullptr)
+				continue;
+
+			props->PreviousPosition = body->GetPosition();
+			props->PreviousRotation = body->GetRotation();
+			props->HasPrevious = true;
+		}
+	}
+
 public:
+
+	// Simulation runs at this rate no matter the frame rate.
+	static float FixedTimeStep;
+
+	// Steps allowed per frame. Time beyond that is dropped so a slow frame can not snowball.
+	static int MaxSubSteps;
+
+	static int CollisionSteps;
+
+	// How far between the last two steps the current frame is, 0..1.
+	static float InterpolationAlpha;
+
+	static int StepsThisFrame;
 	
 	static void AddBody(Body* body)
 	{
 		physicsMainLock.lock();
 
-		existingBodies.push_back(body);
+		SlotHandle handle = existingBodies.Insert(body);
+
+		auto* props = reinterpret_cast<BodyData*>(body->GetUserData());
+		if (props)
+		{
+			props->Handle = handle;
+			props->OwnerHandle = GetOwnerHandle(props->OwnerEntity);
+		}
 
 		bodyInterface->AddBody(body->GetID(), JPH::EActivation::Activate);
 
@@ -342,33 +397,47 @@ public:
 		auto* props = reinterpret_cast<BodyData*>(body->GetUserData());
 		if (props) 
 		{
+			existingBodies.Remove(props->Handle);
 			delete props;
 		}
-			
+		else
+		{
+			for (uint32_t i = 0; i < existingBodies.size(); i++)
+			{
+				if (existingBodies[i] == body)
+				{
+					existingBodies.Remove(existingBodies.HandleAt(i));
+					break;
+				}
+			}
+		}
 
 		bodyInterface->DestroyBody(body->GetID());
 
-		// Remove body from existingBodies
-		auto it = std::find(existingBodies.begin(), existingBodies.end(), body);
-		if (it != existingBodies.end())
-			existingBodies.erase(it);
-
 		physicsMainLock.unlock();
 	}
 
 	static void DestroyAllBodies()
 	{
+		// copied so DestroyBody can take the lock and remove from the list
 		physicsMainLock.lock();
+		vector<Body*> bodies(existingBodies.begin(), existingBodies.end());
+		physicsMainLock.unlock();
 
-		for (Body* body : existingBodies)
+		for (Body* body : bodies)
 		{
 			DestroyBody(body);
 		}
-		existingBodies.clear();
-
-		physicsMainLock.unlock();
 	}
 
+	// Owner of the body, nullptr if it has none or it was removed from the level.
+	static Entity* GetBodyOwner(const Body* body);
+
+	static SlotHandle GetOwnerHandle(Entity* owner);
+
+	// Points the bodies' BodyData at the owner's current level handle.
+	static void UpdateOwnerHandle(Body* body, Entity* owner);
+
 	static void Init()
 	{
 		RegisterDefaultAllocator();
@@ -424,9 +493,53 @@ public:
 
 	static void Simulate()
 	{
-		//physicsMainLock.lock();
-		physics_system->Update(Time::DeltaTime, 1, tempMemAllocator, threadPool);
-		//physicsMainLock.unlock();
+		PROFILE_SCOPE("Physics::Simulate");
+
+		accumulator += Time::DeltaTime;
+
+		StepsThisFrame = 0;
+
+		while (accumulator >= FixedTimeStep && StepsThisFrame < MaxSubSteps)
+		{
+			accumulator -= FixedTimeStep;
+			StepsThisFrame++;
+
+			// only the state before the final step is needed for interpolation
+			bool lastStep = accumulator < FixedTimeStep || StepsThisFrame == MaxSubSteps;
+			if (lastStep)
+				CapturePreviousTransforms();
+
+			//physicsMainLock.lock();
+			physics_system->Update(FixedTimeStep, CollisionSteps, tempMemAllocator, threadPool);
+			//physicsMainLock.unlock();
+		}
+
+		// past the step cap only the fraction of a step is kept, the rest of the time is dropped
+		if (accumulator >= FixedTimeStep)
+			accumulator = std::fmod(accumulator, FixedTimeStep);
+
+		InterpolationAlpha = (float)(accumulator / FixedTimeStep);
+	}
+
+	// Body position blended between the last two fixed steps, for anything that is drawn.
+	static vec3 GetInterpolatedPosition(const Body* body)
+	{
+		auto* props = reinterpret_cast<BodyData*>(body->GetUserData());
+
+		if (props == nullptr || props->HasPrevious == false)
+			return FromPhysics(body->GetPosition());
+
+		return mix(FromPhysics(props->PreviousPosition), FromPhysics(body->GetPosition()), InterpolationAlpha);
+	}
+
+	static quat GetInterpolatedRotation(const Body* body)
+	{
+		auto* props = reinterpret_cast<BodyData*>(body->GetUserData());
+
+		if (props == nullptr || props->HasPrevious == false)
+			return FromPhysics(body->GetRotation());
+
+		return slerp(FromPhysics(props->PreviousRotation), FromPhysics(body->GetRotation()), InterpolationAlpha);
 	}
 
 	static void Update()
@@ -0,0 +1,341 @@
+#include "Profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+#include <algorithm>
+
+#include "gl.h"
+#include "imgui/imgui.h"
+
+bool Profiler::Paused = false;
+
+std::chrono::steady_clock::time_point Profiler::startTime = std::chrono::steady_clock::now();
+
+thread_local int Profiler::threadDepth = 0;
+thread_local Profiler::ThreadBuffer* Profiler::threadBuffer = nullptr;
+
+std::mutex Profiler::registryLock;
+std::vector<std::unique_ptr<Profiler::ThreadBuffer>> Profiler::buffers;
+
+std::unordered_map<std::string, Profiler::ScopeStats> Profiler::cpuStats;
+std::unordered_map<std::string, Profiler::ScopeStats> Profiler::gpuStats;
+
+int Profiler::historyCursor = 0;
+double Profiler::frameStart = 0;
+double Profiler::lastFrameStart = 0;
+
+Profiler::ThreadBuffer& Profiler::GetThreadBuffer()
+{
+	if (threadBuffer == nullptr)
+	{
+		std::lock_guard<std::mutex> guard(registryLock);
+
+		buffers.push_back(std::make_unique<ThreadBuffer>());
+		threadBuffer = buffers.back().get();
+		threadBuffer->Name = "Thread " + std::to_string(buffers.size() - 1);
+	}
+
+	return *threadBuffer;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> guard(buffer.Lock);
+	buffer.Name = name;
+}
+
+void Profiler::Record(const Event& event)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> guard(buffer.Lock);
+	buffer.Events.push_back(event);
+}
+
+// GPU timestamps are read a few frames later so the CPU never waits on the GPU.
+// Timer queries are only exposed on desktop GL; WebGL2 hides them behind an extension
+// most browsers disable, so GPU scopes are skipped there.
+#if DESKTOP
+
+struct GpuScopeQueries
+{
+	const char* Name;
+	GLuint Begin;
+	GLuint End;
+};
+
+struct GpuFrameQueries
+{
+	std::vector<GpuScopeQueries> Scopes;
+	std::vector<GLuint> FreeQueries;
+};
+
+static const int GpuFrameLatency = 3;
+
+static GpuFrameQueries gpuFrames[GpuFrameLatency];
+static int gpuFrameIndex = 0;
+
+static std::vector<size_t> gpuScopeStack;
+
+static GLuint GetGpuQuery(GpuFrameQueries& frame)
+{
+	if (frame.FreeQueries.empty() == false)
+	{
+		GLuint query = frame.FreeQueries.back();
+		frame.FreeQueries.pop_back();
+		return query;
+	}
+
+	GLuint query = 0;
+	glGenQueries(1, &query);
+	return query;
+}
+
+void Profiler::BeginGpuScope(const char* name)
+{
+	GpuFrameQueries& frame = gpuFrames[gpuFrameIndex];
+
+	GpuScopeQueries scope = { name, GetGpuQuery(frame), GetGpuQuery(frame) };
+	glQueryCounter(scope.Begin, GL_TIMESTAMP);
+
+	gpuScopeStack.push_back(frame.Scopes.size());
+	frame.Scopes.push_back(scope);
+}
+
+void Profiler::EndGpuScope()
+{
+	GpuFrameQueries& frame = gpuFrames[gpuFrameIndex];
+
+	size_t scope = gpuScopeStack.back();
+	gpuScopeStack.pop_back();
+
+	glQueryCounter(frame.Scopes[scope].End, GL_TIMESTAMP);
+}
+
+void Profiler::CollectGpuResults(std::unordered_map<std::string, float>& frameTotals)
+{
+	gpuFrameIndex = (gpuFrameIndex + 1) % GpuFrameLatency;
+
+	// the slot about to be reused was recorded GpuFrameLatency frames ago
+	GpuFrameQueries& frame = gpuFrames[gpuFrameIndex];
+
+	for (GpuScopeQueries& scope : frame.Scopes)
+	{
+		GLuint available = 0;
+		glGetQueryObjectuiv(scope.End, GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (available)
+		{
+			GLuint64 begin = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(scope.Begin, GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(scope.End, GL_QUERY_RESULT, &end);
+
+			frameTotals[scope.Name] += (float)((end - begin) / 1000000.0);
+		}
+
+		frame.FreeQueries.push_back(scope.Begin);
+		frame.FreeQueries.push_back(scope.End);
+	}
+
+	frame.Scopes.clear();
+}
+
+#else
+
+void Profiler::BeginGpuScope(const char* name) {}
+void Profiler::EndGpuScope() {}
+void Profiler::CollectGpuResults(std::unordered_map<std::string, float>& frameTotals) {}
+
+#endif // DESKTOP
+
+void Profiler::UpdateStats(std::unordered_map<std::string, ScopeStats>& stats, const std::unordered_map<std::string, float>& frameTotals)
+{
+	for (auto& entry : stats)
+	{
+		entry.second.History[historyCursor] = 0;
+		entry.second.Calls = 0;
+	}
+
+	for (auto& total : frameTotals)
+	{
+		stats[total.first].History[historyCursor] = total.second;
+	}
+
+	for (auto& entry : stats)
+	{
+		ScopeStats& scope = entry.second;
+
+		float sum = 0;
+		float max = 0;
+		for (float value : scope.History)
+		{
+			sum += value;
+			max = std::max(max, value);
+		}
+
+		scope.Average = sum / HistoryLength;
+		scope.Max = max;
+	}
+}
+
+void Profiler::NewFrame()
+{
+	// while paused events are still drained, the last frame just stays on screen
+	double now = Now();
+
+	if (Paused == false)
+	{
+		lastFrameStart = frameStart;
+		frameStart = now;
+	}
+
+	std::unordered_map<std::string, float> cpuTotals;
+	std::unordered_map<std::string, int> cpuCalls;
+
+	{
+		std::lock_guard<std::mutex> guard(registryLock);
+
+		for (auto& buffer : buffers)
+		{
+			std::lock_guard<std::mutex> bufferGuard(buffer->Lock);
+
+			if (Paused == false)
+			{
+				buffer->FrameEvents.swap(buffer->Events);
+
+				for (const Event& event : buffer->FrameEvents)
+				{
+					cpuTotals[event.Name] += (float)(event.End - event.Start);
+					cpuCalls[event.Name]++;
+				}
+			}
+
+			buffer->Events.clear();
+		}
+	}
+
+	std::unordered_map<std::string, float> gpuTotals;
+	CollectGpuResults(gpuTotals);
+
+	if (Paused)
+		return;
+
+	UpdateStats(cpuStats, cpuTotals);
+
+	for (auto& calls : cpuCalls)
+	{
+		cpuStats[calls.first].Calls = calls.second;
+	}
+
+	UpdateStats(gpuStats, gpuTotals);
+
+	historyCursor = (historyCursor + 1) % HistoryLength;
+}
+
+void Profiler::DrawStatsTable(const char* id, const std::unordered_map<std::string, ScopeStats>& stats)
+{
+	if (ImGui::BeginTable(id, 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Sortable))
+	{
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("Avg ms");
+		ImGui::TableSetupColumn("Max ms");
+		ImGui::TableSetupColumn("Calls");
+		ImGui::TableHeadersRow();
+
+		std::vector<std::pair<std::string, const ScopeStats*>> sorted;
+		for (auto& entry : stats)
+			sorted.push_back({ entry.first, &entry.second });
+
+		std::sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) { return a.second->Average > b.second->Average; });
+
+		for (auto& entry : sorted)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(entry.first.c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", entry.second->Average);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", entry.second->Max);
+			ImGui::TableNextColumn(); ImGui::Text("%d", entry.second->Calls);
+		}
+
+		ImGui::EndTable();
+	}
+}
+
+void Profiler::DrawTimeline()
+{
+	const float rowHeight = ImGui::GetTextLineHeight() + 4;
+
+	double start = lastFrameStart;
+	double length = std::max(frameStart - lastFrameStart, 0.001);
+
+	float width = ImGui::GetContentRegionAvail().x;
+
+	std::lock_guard<std::mutex> guard(registryLock);
+
+	for (auto& buffer : buffers)
+	{
+		int maxDepth = 0;
+		for (const Event& event : buffer->FrameEvents)
+			maxDepth = std::max(maxDepth, event.Depth);
+
+		ImGui::TextUnformatted(buffer->Name.c_str());
+
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+		for (const Event& event : buffer->FrameEvents)
+		{
+			// events that started in an earlier frame are clamped to the left edge
+			float x0 = origin.x + (float)(std::max(event.Start - start, 0.0) / length) * width;
+			float x1 = origin.x + (float)((event.End - start) / length) * width;
+			float y0 = origin.y + event.Depth * rowHeight;
+
+			x1 = std::max(x1, x0 + 1);
+
+			ImU32 color = ImGui::GetColorU32(ImVec4(0.25f + 0.15f * (event.Depth % 4), 0.55f, 0.8f - 0.1f * (event.Depth % 4), 1));
+
+			drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y0 + rowHeight - 1), color);
+
+			if (x1 - x0 > 40)
+			{
+				drawList->PushClipRect(ImVec2(x0, y0), ImVec2(x1, y0 + rowHeight), true);
+				drawList->AddText(ImVec2(x0 + 2, y0 + 2), IM_COL32(0, 0, 0, 255), event.Name);
+				drawList->PopClipRect();
+			}
+
+			if (ImGui::IsMouseHoveringRect(ImVec2(x0, y0), ImVec2(x1, y0 + rowHeight)))
+				ImGui::SetTooltip("%s: %.3f ms", event.Name, event.End - event.Start);
+		}
+
+		ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
+	}
+}
+
+void Profiler::DrawImGui()
+{
+	if (ImGui::Begin("Profiler") == false)
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("Frame: %.3f ms", frameStart - lastFrameStart);
+	ImGui::SameLine();
+	ImGui::Checkbox("Pause", &Paused);
+
+	if (ImGui::CollapsingHeader("Timeline", ImGuiTreeNodeFlags_DefaultOpen))
+		DrawTimeline();
+
+	if (ImGui::CollapsingHeader("CPU", ImGuiTreeNodeFlags_DefaultOpen))
+		DrawStatsTable("cpu", cpuStats);
+
+	if (ImGui::CollapsingHeader("GPU"))
+		DrawStatsTable("gpu", gpuStats);
+
+	ImGui::End();
+}
+
+#endif // ENABLE_PROFILER
@@ -0,0 +1,159 @@
+#pragma once
+
+// Frame profiler. Build with ENABLE_PROFILER to record scopes, otherwise every macro
+// below compiles to nothing.
+//
+//  PROFILE_SCOPE("Name")      - CPU time of the enclosing block, on any thread
+//  PROFILE_GPU_SCOPE("Name")  - GPU time of the GL commands issued in the block (render thread, desktop GL)
+//  PROFILE_THREAD("Name")     - names the calling thread in the timeline
+//
+// Profiler::NewFrame() closes a frame on the main thread, Profiler::DrawImGui() shows
+// per-scope averages and maximums and a timeline of the last frame.
+
+#ifdef ENABLE_PROFILER
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Profiler
+{
+public:
+
+	struct Event
+	{
+		const char* Name;
+		int Depth;
+		double Start; // ms since profiler start
+		double End;
+	};
+
+	static double Now()
+	{
+		using namespace std::chrono;
+		return duration<double, std::milli>(steady_clock::now() - startTime).count();
+	}
+
+	static void BeginScope() { threadDepth++; }
+
+	static void EndScope(const char* name, double start)
+	{
+		threadDepth--;
+		Record(Event{ name, threadDepth, start, Now() });
+	}
+
+	static void SetThreadName(const char* name);
+
+	static void BeginGpuScope(const char* name);
+	static void EndGpuScope();
+
+	static void NewFrame();
+
+	static void DrawImGui();
+
+	static bool Paused;
+
+private:
+
+	struct ThreadBuffer
+	{
+		std::string Name;
+		std::mutex Lock;
+		std::vector<Event> Events;
+
+		// events of the last finished frame, shown in the timeline
+		std::vector<Event> FrameEvents;
+	};
+
+	// rolling window the averages and maximums are taken over
+	static const int HistoryLength = 120;
+
+	struct ScopeStats
+	{
+		float History[HistoryLength] = {};
+		int Calls = 0;
+
+		float Average = 0;
+		float Max = 0;
+	};
+
+	static std::chrono::steady_clock::time_point startTime;
+
+	static thread_local int threadDepth;
+	static thread_local ThreadBuffer* threadBuffer;
+
+	static std::mutex registryLock;
+	static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+	static std::unordered_map<std::string, ScopeStats> cpuStats;
+	static std::unordered_map<std::string, ScopeStats> gpuStats;
+
+	static int historyCursor;
+	static double frameStart;
+	static double lastFrameStart;
+
+	static ThreadBuffer& GetThreadBuffer();
+	static void Record(const Event& event);
+
+	static void UpdateStats(std::unordered_map<std::string, ScopeStats>& stats, const std::unordered_map<std::string, float>& frameTotals);
+	static void DrawStatsTable(const char* id, const std::unordered_map<std::string, ScopeStats>& stats);
+	static void DrawTimeline();
+
+	static void CollectGpuResults(std::unordered_map<std::string, float>& frameTotals);
+
+};
+
+class ProfileScope
+{
+public:
+
+	explicit ProfileScope(const char* scopeName) : name(scopeName), start(Profiler::Now())
+	{
+		Profiler::BeginScope();
+	}
+
+	~ProfileScope()
+	{
+		Profiler::EndScope(name, start);
+	}
+
+private:
+
+	const char* name;
+	double start;
+};
+
+class ProfileGpuScope
+{
+public:
+
+	explicit ProfileGpuScope(const char* name) { Profiler::BeginGpuScope(name); }
+	~ProfileGpuScope() { Profiler::EndGpuScope(); }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) ProfileGpuScope PROFILE_CONCAT(profileGpuScope, __LINE__)(name)
+#define PROFILE_THREAD(name) Profiler::SetThreadName(name)
+
+#else
+
+class Profiler
+{
+public:
+
+	static void NewFrame() {}
+	static void DrawImGui() {}
+};
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#define PROFILE_THREAD(name)
+
+#endif // ENABLE_PROFILER
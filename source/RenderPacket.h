@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm.h"
+#include "OcclusionBuffer.h"
+
+class IDrawMesh;
+class Texture;
+class ShaderProgram;
+
+namespace roj
+{
+	struct SkinnedModel;
+}
+
+// One visible draw. Everything render needs is copied out of the live mesh when the
+// packet is built, so drawing never reads state the game thread is changing.
+struct RenderItem
+{
+	IDrawMesh* Mesh = nullptr;
+
+	roj::SkinnedModel* Model = nullptr;
+	Texture* ColorTexture = nullptr;
+
+	mat4 World = mat4(1.0f);
+
+	// range of this draw's matrices in RenderPacket::BonePalette
+	uint32_t BoneOffset = 0;
+	uint32_t BoneCount = 0;
+
+	float Distance = 0;
+
+	// fraction of the screen height the bounds cover, set before FinalizeFrameData
+	float ScreenSize = 0;
+
+	// level of detail to draw, see roj::SkinnedMesh::GetVAO
+	uint8_t Lod = 0;
+
+	// reserved through ShaderManager::ReserveShaderProgram, the render thread Prepares them
+	ShaderProgram* Program = nullptr;
+	ShaderProgram* InstancedProgram = nullptr;
+
+	// inputs of the draw order key, see RenderSort.hpp
+	uint16_t ShaderId = 0;
+	uint16_t MaterialId = 0;
+
+	uint64_t SortKey = 0;
+
+	// 1 for a plain draw. A group leader covers InstanceCount items starting at itself, with
+	// their world matrices at InstanceOffset in RenderPacket::InstanceWorlds; the rest of the
+	// group has 0 and is not drawn on its own.
+	uint32_t InstanceCount = 1;
+	uint32_t InstanceOffset = 0;
+
+	bool IsViewmodel = false;
+	bool Transparent = false;
+};
+
+// Shadow casting light, reported by LevelObject::GetShadowLight.
+struct ShadowLight
+{
+	enum LightType
+	{
+		Directional,
+		Spot
+	};
+
+	LightType Type = Directional;
+
+	// spot: apex of the cone, directional: center of the shadowed box
+	vec3 Position = vec3(0);
+	vec3 Direction = vec3(0, -1, 0);
+
+	// how far the light reaches along Direction, the depth of the box for directional lights
+	float Range = 50;
+
+	// directional: half width of the shadowed box
+	float Extent = 25;
+
+	// spot: half angle of the cone in degrees
+	float OuterAngle = 45;
+
+	mat4 GetView() const
+	{
+		vec3 direction = normalize(Direction);
+		vec3 up = abs(direction.y) > 0.99f ? vec3(1, 0, 0) : vec3(0, 1, 0);
+
+		vec3 eye = Type == Directional ? Position - direction * Range * 0.5f : Position;
+
+		return lookAt(eye, eye + direction, up);
+	}
+
+	mat4 GetProjection() const
+	{
+		if (Type == Directional)
+			return ortho(-Extent, Extent, -Extent, Extent, 0.0f, Range);
+
+		return perspective(radians(OuterAngle * 2.0f), 1.0f, 0.1f, Range);
+	}
+};
+
+// Shadow map pass of one light. Its casters are ranges of RenderPacket::ShadowItems.
+struct ShadowView
+{
+	mat4 View = mat4(1.0f);
+	mat4 Projection = mat4(1.0f);
+
+	// changes whenever the light or the static geometry changed
+	uint64_t StaticKey = 0;
+
+	// set on the first packet with a new StaticKey, the static range is only filled then
+	bool HasStaticCasters = false;
+
+	uint32_t StaticStart = 0;
+	uint32_t StaticCount = 0;
+
+	uint32_t DynamicStart = 0;
+	uint32_t DynamicCount = 0;
+};
+
+// Immutable description of a frame produced by Level::FinalizeFrame.
+struct RenderPacket
+{
+	uint64_t Frame = 0;
+
+	// sorted by SortKey: opaque draws grouped by state, then transparent ones back to front
+	std::vector<RenderItem> Items;
+
+	std::vector<mat4> BonePalette;
+
+	// per instance world matrices of instanced groups
+	std::vector<mat4> InstanceWorlds;
+
+	static const int MaxShadowViews = 2;
+
+	// directional lights first, then the spot lights nearest to the camera
+	std::vector<ShadowView> Shadows;
+
+	// shadow casters of all views, not sorted
+	std::vector<RenderItem> ShadowItems;
+
+	// what occlusion culling did while building the packet
+	OcclusionBuffer::Stats Occlusion;
+
+	void Clear()
+	{
+		Occlusion = OcclusionBuffer::Stats();
+		Items.clear();
+		BonePalette.clear();
+		InstanceWorlds.clear();
+		Shadows.clear();
+		ShadowItems.clear();
+	}
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Packed draw order keys and the radix sort used on them.
+//
+// opaque:      [63 transparent=0][62 layer][61..48 shader][47..32 material][31..0 depth, near first]
+// transparent: [63 transparent=1][62 layer][61..30 depth, far first][29..16 shader][15..0 material]
+//
+// Opaque draws are grouped by state and only ordered by depth within a group; transparent
+// draws have to stay back to front, so depth comes before state for them.
+// Opaque viewmodels are drawn before the world so they fill depth first, transparent ones
+// after it so they stay on top.
+namespace RenderSort
+{
+	const uint32_t ShaderBits = 14;
+	const uint32_t ShaderMask = (1u << ShaderBits) - 1;
+
+	const uint16_t InvalidShaderId = 0xFFFF;
+
+	// Stable id for a shader name. Collisions only cost grouping, never correctness.
+	inline uint16_t HashName(const std::string& name)
+	{
+		uint32_t hash = 2166136261u;
+		for (char c : name)
+		{
+			hash ^= (uint8_t)c;
+			hash *= 16777619u;
+		}
+
+		return (uint16_t)((hash ^ (hash >> 16)) & ShaderMask);
+	}
+
+	// Maps any pointer or GL name to 16 bits.
+	inline uint16_t HashId(uint64_t value)
+	{
+		value ^= value >> 33;
+		value *= 0xff51afd7ed558ccdull;
+		value ^= value >> 33;
+		return (uint16_t)value;
+	}
+
+	// Non-negative float bits keep their order when read as an unsigned int.
+	inline uint32_t DepthBits(float distance)
+	{
+		if (!(distance > 0.0f))
+			return 0;
+
+		uint32_t bits;
+		memcpy(&bits, &distance, sizeof(bits));
+		return bits;
+	}
+
+	inline uint64_t MakeKey(bool transparent, bool viewmodel, uint16_t shader, uint16_t material, float distance)
+	{
+		uint64_t key = 0;
+
+		key |= (uint64_t)(transparent ? 1 : 0) << 63;
+		key |= (uint64_t)(viewmodel == transparent ? 1 : 0) << 62;
+
+		uint64_t shaderBits = shader & ShaderMask;
+		uint32_t depth = DepthBits(distance);
+
+		if (transparent)
+		{
+			key |= (uint64_t)(~depth) << 30;
+			key |= shaderBits << 16;
+			key |= material;
+		}
+		else
+		{
+			key |= shaderBits << 48;
+			key |= (uint64_t)material << 32;
+			key |= depth;
+		}
+
+		return key;
+	}
+
+	struct KeyIndex
+	{
+		uint64_t Key;
+		uint32_t Index;
+	};
+
+	// LSD radix sort, 8 bits per pass. Passes where every key has the same byte are skipped,
+	// which is common for the high bytes. Stable, so equal keys keep submission order.
+	inline void RadixSort(std::vector<KeyIndex>& entries, std::vector<KeyIndex>& scratch)
+	{
+		size_t count = entries.size();
+		if (count < 2)
+			return;
+
+		scratch.resize(count);
+
+		uint32_t histograms[8][256] = {};
+
+		for (const KeyIndex& entry : entries)
+		{
+			for (int pass = 0; pass < 8; pass++)
+				histograms[pass][(entry.Key >> (pass * 8)) & 0xFF]++;
+		}
+
+		KeyIndex* source = entries.data();
+		KeyIndex* destination = scratch.data();
+
+		for (int pass = 0; pass < 8; pass++)
+		{
+			uint32_t* histogram = histograms[pass];
+
+			uint32_t firstByte = (source[0].Key >> (pass * 8)) & 0xFF;
+			if (histogram[firstByte] == count)
+				continue;
+
+			uint32_t offset = 0;
+			for (int i = 0; i < 256; i++)
+			{
+				uint32_t bucket = histogram[i];
+				histogram[i] = offset;
+				offset += bucket;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				uint32_t byte = (source[i].Key >> (pass * 8)) & 0xFF;
+				destination[histogram[byte]++] = source[i];
+			}
+
+			std::swap(source, destination);
+		}
+
+		if (source != entries.data())
+			memcpy(entries.data(), source, count * sizeof(KeyIndex));
+	}
+}
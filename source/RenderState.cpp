@@ -0,0 +1,144 @@
+#include "RenderState.h"
+
+RenderState::Counters RenderState::LastFrame;
+RenderState::Counters RenderState::current;
+
+GLuint RenderState::program = RenderState::Unknown;
+GLuint RenderState::vertexArray = RenderState::Unknown;
+
+GLuint RenderState::arrayBuffer = RenderState::Unknown;
+GLuint RenderState::elementBuffer = RenderState::Unknown;
+GLuint RenderState::uniformBuffer = RenderState::Unknown;
+
+GLuint RenderState::activeUnit = RenderState::Unknown;
+GLuint RenderState::textures[RenderState::MaxTextureUnits];
+
+void RenderState::UseProgram(GLuint value)
+{
+	if (Changes(program, value))
+		glUseProgram(value);
+}
+
+void RenderState::BindVertexArray(GLuint value)
+{
+	if (Changes(vertexArray, value) == false)
+		return;
+
+	glBindVertexArray(value);
+
+	// the element buffer binding belongs to the vertex array
+	elementBuffer = Unknown;
+}
+
+GLuint* RenderState::GetBufferBinding(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return &arrayBuffer;
+	case GL_ELEMENT_ARRAY_BUFFER: return &elementBuffer;
+	case GL_UNIFORM_BUFFER: return &uniformBuffer;
+	}
+
+	return nullptr;
+}
+
+void RenderState::BindBuffer(GLenum target, GLuint buffer)
+{
+	GLuint* cached = GetBufferBinding(target);
+
+	if (cached == nullptr)
+	{
+		current.Issued++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+
+	if (Changes(*cached, buffer))
+		glBindBuffer(target, buffer);
+}
+
+void RenderState::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	current.Issued++;
+	glBindBufferBase(target, index, buffer);
+
+	if (GLuint* cached = GetBufferBinding(target))
+		*cached = buffer;
+}
+
+void RenderState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	current.Issued++;
+	glBindBufferRange(target, index, buffer, offset, size);
+
+	if (GLuint* cached = GetBufferBinding(target))
+		*cached = buffer;
+}
+
+void RenderState::ActiveTexture(GLuint unit)
+{
+	if (Changes(activeUnit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void RenderState::BindTexture(GLenum target, GLuint texture)
+{
+	if (target != GL_TEXTURE_2D || activeUnit >= MaxTextureUnits)
+	{
+		current.Issued++;
+		glBindTexture(target, texture);
+		return;
+	}
+
+	if (Changes(textures[activeUnit], texture))
+		glBindTexture(target, texture);
+}
+
+void RenderState::OnBufferDeleted(GLuint buffer)
+{
+	if (arrayBuffer == buffer)
+		arrayBuffer = Unknown;
+	if (elementBuffer == buffer)
+		elementBuffer = Unknown;
+	if (uniformBuffer == buffer)
+		uniformBuffer = Unknown;
+}
+
+void RenderState::OnVertexArrayDeleted(GLuint value)
+{
+	if (vertexArray == value)
+	{
+		vertexArray = Unknown;
+		elementBuffer = Unknown;
+	}
+}
+
+void RenderState::OnTextureDeleted(GLuint texture)
+{
+	for (GLuint& bound : textures)
+	{
+		if (bound == texture)
+			bound = Unknown;
+	}
+}
+
+void RenderState::Invalidate()
+{
+	program = Unknown;
+	vertexArray = Unknown;
+
+	arrayBuffer = Unknown;
+	elementBuffer = Unknown;
+	uniformBuffer = Unknown;
+
+	activeUnit = Unknown;
+
+	for (GLuint& bound : textures)
+		bound = Unknown;
+}
+
+void RenderState::NewFrame()
+{
+	LastFrame = current;
+	current = Counters();
+}
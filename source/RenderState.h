@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+
+#include "gl.h"
+
+// Shadow copy of the GL bindings the engine changes most. Every call compares against
+// what is already bound and skips the GL call if nothing would change; on WebGL each
+// skipped call is a JS round trip saved.
+//
+// All engine code binds programs, vertex arrays, buffers and 2D textures through here.
+// Code that binds behind its back (ImGui's backend) has to be followed by Invalidate().
+// Deleting a bound object resets the binding in GL, so deletions are reported too.
+class RenderState
+{
+public:
+
+	static const int MaxTextureUnits = 32;
+
+	struct Counters
+	{
+		uint32_t Issued = 0;
+		uint32_t Skipped = 0;
+	};
+
+	// counts of the last finished frame
+	static Counters LastFrame;
+
+	static void UseProgram(GLuint program);
+
+	static void BindVertexArray(GLuint vertexArray);
+
+	// GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_UNIFORM_BUFFER are tracked, other targets go straight through.
+	static void BindBuffer(GLenum target, GLuint buffer);
+
+	// Indexed binds also change the generic binding of the target, which is tracked accordingly.
+	static void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	static void ActiveTexture(GLuint unit);
+
+	// Binds to the active unit. GL_TEXTURE_2D is tracked, other targets go straight through.
+	static void BindTexture(GLenum target, GLuint texture);
+
+	static void BindTexture(GLuint unit, GLenum target, GLuint texture)
+	{
+		ActiveTexture(unit);
+		BindTexture(target, texture);
+	}
+
+	static void OnBufferDeleted(GLuint buffer);
+	static void OnVertexArrayDeleted(GLuint vertexArray);
+	static void OnTextureDeleted(GLuint texture);
+
+	// For state changes the cache could not see, e.g. a skipped uniform upload.
+	static void CountSkipped() { current.Skipped++; }
+
+	// Forgets every binding, the next call of each kind goes to GL.
+	static void Invalidate();
+
+	static void NewFrame();
+
+private:
+
+	// Unknown is never a valid GL name, so nothing compares equal to it
+	static const GLuint Unknown = 0xFFFFFFFF;
+
+	static Counters current;
+
+	static GLuint program;
+	static GLuint vertexArray;
+
+	static GLuint arrayBuffer;
+	static GLuint elementBuffer;
+	static GLuint uniformBuffer;
+
+	static GLuint activeUnit;
+	static GLuint textures[MaxTextureUnits];
+
+	static GLuint* GetBufferBinding(GLenum target);
+
+	static bool Changes(GLuint& cached, GLuint value)
+	{
+		if (cached == value)
+		{
+			current.Skipped++;
+			return false;
+		}
+
+		cached = value;
+		current.Issued++;
+		return true;
+	}
+
+};
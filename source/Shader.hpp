@@ -9,8 +9,17 @@
 
 #include "Texture.hpp"
 
+#include "UniformBuffers.h"
+#include "BoneTexture.h"
+#include "ShadowMaps.h"
+#include "RenderState.h"
+
 using namespace std;
 
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 enum ShaderType
 {
     VertexShader,
@@ -34,6 +43,8 @@ public:
     GLuint shaderPointer = 0;
     std::string shaderCode = "";
 
+    bool compiled = false;
+
     ShaderType shaderType = ShaderType::PixelShader;
 
     // Creates a Shader object from source code.
@@ -60,8 +71,22 @@ public:
     // Compiles the shader and logs compile errors if any.
     void CompileShader()
     {
+        StartCompile();
+        LogCompileErrors();
+    }
+
+    // Issues the compile without waiting for it, the status is read when the program links.
+    void StartCompile()
+    {
+        if (compiled)
+            return;
+
         glCompileShader(shaderPointer);
+        compiled = true;
+    }
 
+    void LogCompileErrors()
+    {
         GLint success = 0;
         glGetShaderiv(shaderPointer, GL_COMPILE_STATUS, &success);
         if (success == GL_FALSE)
@@ -86,35 +111,92 @@ private:
 
 
 public:
-    GLuint program;
+    // set by ShaderManager::Init when the driver reports link completion without blocking
+    static bool ParallelCompile;
+
+    // 0 until Create, ShaderManager reserves programs before the GL object exists
+    GLuint program = 0;
     std::vector<GLAttribute> attributes;  // Stores shader attributes.
     std::unordered_map<std::string, GLint> uniformLocations; // Cache for uniform locations.
 
     string name;
 
+    string vertexShaderName;
+    string pixelShaderName;
+
+    // shaders attached for compiling, the binary cache links without them
+    std::vector<Shader*> shaders;
+
+    // the link was issued and its status not read yet
+    bool linkPending = false;
+
+    bool linked = false;
+
     bool AllowMissingUniforms = true;
 
-    ShaderProgram() {
+    ShaderProgram() {}
+
+    // Creates the GL program, on the render thread.
+    void Create() {
         glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, (GLint*)&m_maxTextureUnits);
+
+        // the shadow maps and the bone palette have units of their own
+        if (m_maxTextureUnits > ShadowMaps::FirstTextureUnit)
+            m_maxTextureUnits = ShadowMaps::FirstTextureUnit;
         program = glCreateProgram();
     }
 
     // Attaches a compiled shader to the program.
     ShaderProgram* AttachShader(Shader* shader)
     {
+        shader->StartCompile();
         glAttachShader(program, shader->shaderPointer);
+        shaders.push_back(shader);
         return this;
     }
 
     // Links the program.
     ShaderProgram* LinkProgram()
+    {
+        StartLink();
+        FinishLink();
+        return this;
+    }
+
+    // Issues the link without reading anything back, which would wait for the driver.
+    void StartLink()
     {
         glLinkProgram(program);
+        linkPending = true;
+    }
+
+    // True once FinishLink won't block. Without parallel compile support it can't be
+    // known, so the link counts as done and FinishLink waits for it.
+    bool IsLinkComplete()
+    {
+        if (linkPending == false || ParallelCompile == false)
+            return true;
+
+        GLint complete = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+
+    // Reads the link status and fills the attribute and uniform caches, returns false if linking failed.
+    bool FinishLink()
+    {
+        if (linkPending == false)
+            return linked;
+
+        linkPending = false;
 
         GLint success;
         glGetProgramiv(program, GL_LINK_STATUS, &success);
         if (success == GL_FALSE)
         {
+            for (Shader* shader : shaders)
+                shader->LogCompileErrors();
+
             GLint logLength = 0;
             glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
             std::string infoLog(logLength, ' ');
@@ -122,15 +204,51 @@ public:
             Logger::Log("Shader program linking failed:\n" + infoLog);
         }
 
+        linked = success == GL_TRUE;
+
         FillAttributes();
         CacheUniformLocations();
-        return this;
+        BindUniformBlocks();
+        return linked;
+    }
+
+    // Points the shared uniform blocks and the bone palette and shadow map samplers the program declares at their binding points.
+    void BindUniformBlocks()
+    {
+        GLuint frameBlock = glGetUniformBlockIndex(program, "FrameData");
+        if (frameBlock != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, frameBlock, UniformBuffers::FrameBinding);
+
+        GLuint objectBlock = glGetUniformBlockIndex(program, "ObjectData");
+        if (objectBlock != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, objectBlock, UniformBuffers::ObjectBinding);
+
+        GLuint shadowBlock = glGetUniformBlockIndex(program, "ShadowData");
+        if (shadowBlock != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, shadowBlock, ShadowMaps::ShadowBinding);
+
+        GLint bonePalette = glGetUniformLocation(program, "bonePalette");
+        if (bonePalette != -1)
+        {
+            RenderState::UseProgram(program);
+            glUniform1i(bonePalette, BoneTexture::TextureUnit);
+        }
+
+        for (int i = 0; i < RenderPacket::MaxShadowViews; i++)
+        {
+            GLint shadowMap = glGetUniformLocation(program, ("shadowMap" + to_string(i)).c_str());
+            if (shadowMap != -1)
+            {
+                RenderState::UseProgram(program);
+                glUniform1i(shadowMap, ShadowMaps::FirstTextureUnit + i);
+            }
+        }
     }
 
     // Activates the program.
     void UseProgram()
     {
-        glUseProgram(program);
+        RenderState::UseProgram(program);
     }
 
     // Fills the attributes vector by querying the linked program.
@@ -201,11 +319,13 @@ public:
         return -1;
     }
 
+    // Sampler uniforms keep their value, so the unit is only written when a name gets one.
     void SetTexture(const std::string& name, GLuint texture) {
         GLint location = GetUniformLocation(name);
         if (location == -1) return;
 
         // Find or assign texture unit
+        GLuint unit;
         auto it = m_textureUnits.find(name);
         if (it == m_textureUnits.end()) {
             if (m_currentUnit >= m_maxTextureUnits) {
@@ -213,38 +333,21 @@ public:
                     std::to_string(m_maxTextureUnits));
                 return;
             }
-            m_textureUnits[name] = m_currentUnit++;
-        }
+            unit = m_currentUnit++;
+            m_textureUnits[name] = unit;
 
-        GLuint unit = m_textureUnits[name];
+            glUniform1i(location, unit);
+        }
+        else {
+            unit = it->second;
+            RenderState::CountSkipped();
+        }
 
-        // Bind texture and update uniform
-        glActiveTexture(GL_TEXTURE0 + unit);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glUniform1i(location, unit);
+        RenderState::BindTexture(unit, GL_TEXTURE_2D, texture);
     }
 
     void SetTexture(const std::string& name, Texture* texture) {
-        GLint location = GetUniformLocation(name);
-        if (location == -1) return;
-
-        // Find or assign texture unit
-        auto it = m_textureUnits.find(name);
-        if (it == m_textureUnits.end()) {
-            if (m_currentUnit >= m_maxTextureUnits) {
-                Logger::Log("Texture unit overflow! Maximum: " +
-                    std::to_string(m_maxTextureUnits));
-                return;
-            }
-            m_textureUnits[name] = m_currentUnit++;
-        }
-
-        GLuint unit = m_textureUnits[name];
-
-        // Bind texture and update uniform
-        glActiveTexture(GL_TEXTURE0 + unit);
-        glBindTexture(GL_TEXTURE_2D, texture == nullptr? 0 : texture->getID());
-        glUniform1i(location, unit);
+        SetTexture(name, texture == nullptr ? 0 : texture->getID());
     }
 
     // === Uniform setting functions with cached locations ===
@@ -1,3 +1,289 @@
 #include "ShaderManager.h"
 
-std::unordered_map<std::string, ShaderProgram> ShaderManager::shaderProgramCache;
\ No newline at end of file
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#if DESKTOP
+#include <filesystem>
+#include <fstream>
+#else
+#include <emscripten/html5.h>
+#endif
+
+std::unordered_map<std::string, ShaderProgram> ShaderManager::shaderProgramCache;
+std::mutex ShaderManager::cacheLock;
+std::vector<ShaderProgram*> ShaderManager::pendingPrograms;
+std::unordered_map<const ShaderProgram*, uint64_t> ShaderManager::unsavedBinaries;
+bool ShaderManager::binaryCacheSupported = false;
+
+const char* ShaderManager::BinaryCachePath = "ShaderCache/";
+
+bool ShaderProgram::ParallelCompile = false;
+
+static void HashBytes(uint64_t& hash, const char* data, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (uint8_t)data[i];
+		hash *= 1099511628211ull;
+	}
+
+	// separates consecutive strings
+	hash ^= 0xFF;
+	hash *= 1099511628211ull;
+}
+
+static void HashString(uint64_t& hash, const char* text)
+{
+	HashBytes(hash, text == nullptr ? "" : text, text == nullptr ? 0 : strlen(text));
+}
+
+void ShaderManager::Init()
+{
+#if DESKTOP
+	ShaderProgram::ParallelCompile = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+
+	GLint binaryFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+	binaryCacheSupported = binaryFormats > 0;
+
+	if (binaryCacheSupported)
+		std::filesystem::create_directories(BinaryCachePath);
+#else
+	// WebGL has no program binaries, only the parallel compile extension helps here
+	ShaderProgram::ParallelCompile = emscripten_webgl_enable_extension(emscripten_webgl_get_current_context(), "KHR_parallel_shader_compile");
+#endif
+
+	Logger::Log(std::string("parallel shader compile: ") + (ShaderProgram::ParallelCompile ? "yes" : "no") +
+		", program binary cache: " + (binaryCacheSupported ? "yes" : "no"));
+}
+
+ShaderProgram* ShaderManager::GetShaderProgram(const std::string& vertexShaderName, const std::string& pixelShaderName, ShaderProgram* cached)
+{
+	return Prepare(ReserveShaderProgram(vertexShaderName, pixelShaderName));
+}
+
+ShaderProgram* ShaderManager::ReserveShaderProgram(const std::string& vertexShaderName, const std::string& pixelShaderName)
+{
+	std::string key = vertexShaderName + pixelShaderName; // Unique key for shader program
+
+	std::lock_guard<std::mutex> guard(cacheLock);
+
+	// Check if the program is already cached
+	auto it = shaderProgramCache.find(key);
+	if (it != shaderProgramCache.end())
+		return &(it->second); // Return cached program
+
+	// map nodes don't move, so the pointer stays valid while others are added
+	ShaderProgram& program = shaderProgramCache[key];
+	program.name = key;
+	program.vertexShaderName = vertexShaderName;
+	program.pixelShaderName = pixelShaderName;
+
+	return &program;
+}
+
+ShaderProgram* ShaderManager::Prepare(ShaderProgram* program)
+{
+	if (program->program == 0)
+		CreateProgram(*program);
+
+	// prewarmed but not polled yet, this waits for the rest of its link
+	if (program->linkPending)
+		FinishProgram(*program);
+
+	return program;
+}
+
+void ShaderManager::Prewarm(const std::vector<ProgramName>& programs)
+{
+	for (const ProgramName& name : programs)
+	{
+		ShaderProgram* program = ReserveShaderProgram(name.VertexShader, name.PixelShader);
+
+		if (program->program != 0)
+			continue;
+
+		CreateProgram(*program);
+
+		if (program->linkPending)
+			pendingPrograms.push_back(program);
+	}
+
+	// without completion polling the status reads would block later anyway, so take the wait
+	// now while loading; the compiles were all issued first, so the driver could overlap them
+	if (ShaderProgram::ParallelCompile == false)
+	{
+		while (pendingPrograms.empty() == false)
+			FinishProgram(*pendingPrograms.back());
+	}
+}
+
+void ShaderManager::Update()
+{
+	for (size_t i = 0; i < pendingPrograms.size();)
+	{
+		ShaderProgram* program = pendingPrograms[i];
+
+		if (program->IsLinkComplete())
+			FinishProgram(*program); // removes it from the list
+		else
+			i++;
+	}
+}
+
+void ShaderManager::CreateProgram(ShaderProgram& program)
+{
+	program.Create();
+
+	// Load shaders
+	Shader* vertexShader = AssetRegistry::GetShaderByName(program.vertexShaderName, ShaderType::VertexShader);
+	Shader* pixelShader = AssetRegistry::GetShaderByName(program.pixelShaderName, ShaderType::PixelShader);
+
+	if (binaryCacheSupported)
+	{
+		uint64_t hash = HashSources(vertexShader, pixelShader);
+
+		if (LoadProgramBinary(program, hash))
+			return;
+
+		unsavedBinaries[&program] = hash;
+
+#if DESKTOP
+		glProgramParameteri(program.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+	}
+
+	// Create and link the shader program
+	program.AttachShader(vertexShader)->AttachShader(pixelShader);
+	program.StartLink();
+}
+
+void ShaderManager::FinishProgram(ShaderProgram& program)
+{
+	pendingPrograms.erase(std::remove(pendingPrograms.begin(), pendingPrograms.end(), &program), pendingPrograms.end());
+
+	bool linked = program.FinishLink();
+
+	auto it = unsavedBinaries.find(&program);
+	if (it == unsavedBinaries.end())
+		return;
+
+	if (linked)
+		SaveProgramBinary(program, it->second);
+
+	unsavedBinaries.erase(it);
+}
+
+uint64_t ShaderManager::HashSources(const Shader* vertexShader, const Shader* pixelShader)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	HashBytes(hash, vertexShader->shaderCode.data(), vertexShader->shaderCode.size());
+	HashBytes(hash, pixelShader->shaderCode.data(), pixelShader->shaderCode.size());
+
+	// binaries only load on the driver that wrote them
+	HashString(hash, (const char*)glGetString(GL_VENDOR));
+	HashString(hash, (const char*)glGetString(GL_RENDERER));
+	HashString(hash, (const char*)glGetString(GL_VERSION));
+
+	return hash;
+}
+
+#if DESKTOP
+
+static std::string GetBinaryFilePath(uint64_t hash)
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)hash);
+
+	return std::string(ShaderManager::BinaryCachePath) + fileName;
+}
+
+bool ShaderManager::LoadProgramBinary(ShaderProgram& program, uint64_t hash)
+{
+	std::ifstream file(GetBinaryFilePath(hash), std::ios::binary);
+	if (!file)
+		return false;
+
+	GLenum format = 0;
+	file.read((char*)&format, sizeof(format));
+
+	std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (!file.eof() || binary.empty())
+		return false;
+
+	glProgramBinary(program.program, format, binary.data(), (GLsizei)binary.size());
+
+	// a driver update can reject old binaries, the program is compiled from source then
+	GLint success = GL_FALSE;
+	glGetProgramiv(program.program, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE)
+		return false;
+
+	program.linkPending = true;
+
+	return true;
+}
+
+void ShaderManager::SaveProgramBinary(const ShaderProgram& program, uint64_t hash)
+{
+	GLint length = 0;
+	glGetProgramiv(program.program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program.program, length, &length, &format, binary.data());
+
+	std::ofstream file(GetBinaryFilePath(hash), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		Logger::Log("Failed to write program binary for " + program.name);
+		return;
+	}
+
+	file.write((const char*)&format, sizeof(format));
+	file.write(binary.data(), length);
+}
+
+#else
+
+bool ShaderManager::LoadProgramBinary(ShaderProgram& program, uint64_t hash)
+{
+	return false;
+}
+
+void ShaderManager::SaveProgramBinary(const ShaderProgram& program, uint64_t hash)
+{
+}
+
+#endif
+
+std::vector<ShaderManager::ProgramName> ShaderManager::LoadManifest(const std::string& filePath)
+{
+	std::vector<ProgramName> programs;
+
+	std::istringstream stream(AssetRegistry::ReadFileToString(filePath));
+	std::string line;
+
+	while (std::getline(stream, line))
+	{
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.resize(comment);
+
+		ProgramName name;
+
+		std::istringstream words(line);
+		if (words >> name.VertexShader >> name.PixelShader)
+			programs.push_back(name);
+	}
+
+	return programs;
+}
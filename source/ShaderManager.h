@@ -4,33 +4,75 @@
 
 #include "AssetRegisty.h"
 
+#include <mutex>
+
+// Shader programs by vertex and pixel shader name.
+//
+// ReserveShaderProgram hands out a program from any thread without touching GL, so the game
+// thread can pick programs while building a frame; the render thread creates it in Prepare.
+// Programs are linked on first use, or ahead of time by Prewarm at level load. Prewarm issues
+// every compile and link without reading anything back; with KHR_parallel_shader_compile the
+// driver compiles them in the background and Update finishes the ones that are done without
+// blocking. A program still in flight when it is first asked for is finished right there.
+//
+// On desktop, linked programs are stored with glGetProgramBinary under BinaryCachePath, keyed by
+// a hash of their sources and the driver, and loaded with glProgramBinary instead of compiling.
 class ShaderManager
 {
+public:
+    struct ProgramName
+    {
+        std::string VertexShader;
+        std::string PixelShader;
+    };
+
+    static const char* BinaryCachePath;
+
 private:
     static std::unordered_map<std::string, ShaderProgram> shaderProgramCache;
 
+    // guards shaderProgramCache, which reservations from the game thread insert into
+    static std::mutex cacheLock;
+
+    // linked by Prewarm, status not read yet
+    static std::vector<ShaderProgram*> pendingPrograms;
+
+    // programs compiled from source whose binary is written once they link
+    static std::unordered_map<const ShaderProgram*, uint64_t> unsavedBinaries;
+
+    static bool binaryCacheSupported;
+
+    static void CreateProgram(ShaderProgram& program);
+    static void FinishProgram(ShaderProgram& program);
+
+    static uint64_t HashSources(const Shader* vertexShader, const Shader* pixelShader);
+    static bool LoadProgramBinary(ShaderProgram& program, uint64_t hash);
+    static void SaveProgramBinary(const ShaderProgram& program, uint64_t hash);
+
 public:
-    static ShaderProgram* GetShaderProgram(const std::string& vertexShaderName = "default_vertex", const std::string& pixelShaderName = "default_pixel", ShaderProgram* cached = nullptr)
-    {
-        std::string key = vertexShaderName + pixelShaderName; // Unique key for shader program
+    // Call once with the context current.
+    static void Init();
 
-        // Check if the program is already cached
-        auto it = shaderProgramCache.find(key);
-        if (it != shaderProgramCache.end())
-        {
-            return &(it->second); // Return cached program
-        }
+    // Any thread. The program stays at this address; pass it through Prepare before use.
+    static ShaderProgram* ReserveShaderProgram(const std::string& vertexShaderName, const std::string& pixelShaderName);
 
-        // Load shaders
-        Shader* vertexShader = AssetRegistry::GetShaderByName(vertexShaderName, ShaderType::VertexShader);
-        Shader* pixelShader = AssetRegistry::GetShaderByName(pixelShaderName, ShaderType::PixelShader);
+    // Render thread. Compiles and links a reserved program that isn't yet, and waits for a
+    // prewarmed one that is still linking.
+    static ShaderProgram* Prepare(ShaderProgram* program);
 
-        // Create and link the shader program
-        ShaderProgram& program = shaderProgramCache[key];
-        program.AttachShader(vertexShader)->AttachShader(pixelShader)->LinkProgram();
+    static ShaderProgram* GetShaderProgram(const std::string& vertexShaderName = "default_vertex", const std::string& pixelShaderName = "default_pixel", ShaderProgram* cached = nullptr);
 
-        program.name = key;
+    // Starts compiling and linking the programs that don't exist yet.
+    static void Prewarm(const std::vector<ProgramName>& programs);
 
-        return &program;
+    // Finishes prewarmed programs whose link completed, never blocks. Call once per frame.
+    static void Update();
+
+    static size_t GetPendingCount()
+    {
+        return pendingPrograms.size();
     }
+
+    // Reads "vertex pixel" pairs, one per line, '#' starts a comment.
+    static std::vector<ProgramName> LoadManifest(const std::string& filePath);
 };
@@ -0,0 +1,174 @@
+#include "ShadowMaps.h"
+
+#include "IDrawMesh.h"
+#include "RenderState.h"
+#include "UniformBuffers.h"
+
+uint32_t ShadowMaps::StaticRebuilds = 0;
+
+ShadowMaps::Slot ShadowMaps::slots[RenderPacket::MaxShadowViews];
+
+GLuint ShadowMaps::dataBuffer = 0;
+GLuint ShadowMaps::emptyTexture = 0;
+
+void ShadowMaps::Init()
+{
+	glGenBuffers(1, &dataBuffer);
+	RenderState::BindBuffer(GL_UNIFORM_BUFFER, dataBuffer);
+
+	ShadowData data = {};
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowData), &data, GL_DYNAMIC_DRAW);
+	RenderState::BindBufferBase(GL_UNIFORM_BUFFER, ShadowBinding, dataBuffer);
+
+	emptyTexture = CreateDepthTexture(1, true);
+
+	for (int i = 0; i < RenderPacket::MaxShadowViews; i++)
+		RenderState::BindTexture(FirstTextureUnit + i, GL_TEXTURE_2D, emptyTexture);
+
+	RenderState::ActiveTexture(0);
+}
+
+GLuint ShadowMaps::CreateDepthTexture(int size, bool compare)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+
+	RenderState::BindTexture(GL_TEXTURE_2D, texture);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	if (compare)
+	{
+		// hardware 2x2 comparison filtering
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+	else
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	return texture;
+}
+
+GLuint ShadowMaps::CreateFramebuffer(GLuint depthTexture)
+{
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+	GLenum none = GL_NONE;
+	glDrawBuffers(1, &none);
+	glReadBuffer(GL_NONE);
+
+	// starts out empty until the first static casters arrive
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	return framebuffer;
+}
+
+ShadowMaps::Slot& ShadowMaps::GetSlot(int index)
+{
+	Slot& slot = slots[index];
+
+	if (slot.Texture == 0)
+	{
+		slot.StaticTexture = CreateDepthTexture(Resolution, false);
+		slot.StaticFramebuffer = CreateFramebuffer(slot.StaticTexture);
+
+		slot.Texture = CreateDepthTexture(Resolution, true);
+		slot.Framebuffer = CreateFramebuffer(slot.Texture);
+	}
+
+	return slot;
+}
+
+void ShadowMaps::InvalidateStatic()
+{
+	for (Slot& slot : slots)
+		slot.StaticKey = 0;
+}
+
+void ShadowMaps::DrawCasters(const RenderPacket& packet, const ShadowView& view, uint32_t start, uint32_t count)
+{
+	for (uint32_t i = start; i < start + count; i++)
+	{
+		const RenderItem& item = packet.ShadowItems[i];
+		item.Mesh->DrawShadow(item, packet, view.View, view.Projection);
+	}
+}
+
+void ShadowMaps::Render(const RenderPacket& packet)
+{
+	ShadowData data = {};
+
+	int viewCount = (int)packet.Shadows.size();
+	if (viewCount > RenderPacket::MaxShadowViews)
+		viewCount = RenderPacket::MaxShadowViews;
+
+	if (viewCount > 0)
+	{
+		glViewport(0, 0, Resolution, Resolution);
+
+		glEnable(GL_DEPTH_TEST);
+		glDepthMask(GL_TRUE);
+
+		// slope scaled offset keeps lit surfaces from shadowing themselves
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(1.5f, 4.0f);
+	}
+
+	for (int i = 0; i < viewCount; i++)
+	{
+		const ShadowView& view = packet.Shadows[i];
+		Slot& slot = GetSlot(i);
+
+		UniformBuffers::SetFrame(view.View, view.Projection, view.Projection, vec3(inverse(view.View)[3]), 1 + i);
+
+		if (view.HasStaticCasters && view.StaticKey != slot.StaticKey)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, slot.StaticFramebuffer);
+			glClear(GL_DEPTH_BUFFER_BIT);
+
+			DrawCasters(packet, view, view.StaticStart, view.StaticCount);
+
+			slot.StaticKey = view.StaticKey;
+			StaticRebuilds++;
+		}
+
+		// start from the cached static depth and add what moves
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, slot.StaticFramebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, slot.Framebuffer);
+		glBlitFramebuffer(0, 0, Resolution, Resolution, 0, 0, Resolution, Resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, slot.Framebuffer);
+
+		DrawCasters(packet, view, view.DynamicStart, view.DynamicCount);
+
+		data.Matrices[i] = view.Projection * view.View;
+		data.Params[i] = vec4(1.0f, 0.0005f, 1.0f / Resolution, 0.0f);
+	}
+
+	if (viewCount > 0)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDisable(GL_POLYGON_OFFSET_FILL);
+	}
+
+	RenderState::BindBuffer(GL_UNIFORM_BUFFER, dataBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowData), &data);
+	RenderState::BindBufferBase(GL_UNIFORM_BUFFER, ShadowBinding, dataBuffer);
+
+	for (int i = 0; i < RenderPacket::MaxShadowViews; i++)
+		RenderState::BindTexture(FirstTextureUnit + i, GL_TEXTURE_2D, i < viewCount ? slots[i].Texture : emptyTexture);
+
+	RenderState::ActiveTexture(0);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+
+#include "gl.h"
+#include "glm.h"
+#include "RenderPacket.h"
+#include "BoneTexture.h"
+
+// Depth maps of the shadow views in a packet (RenderPacket::Shadows).
+//
+// Every view has two depth textures. The static one holds only the static casters and is
+// redrawn when the packet brings them, which Level does only when the light or the static
+// geometry changed. Every frame the static depth is blitted into the second texture and
+// the dynamic casters are drawn on top, so the expensive brush geometry is not redrawn.
+//
+// Shaders sample the second textures as sampler2DShadow shadowMap0, shadowMap1 ... from
+// units FirstTextureUnit and up, and find the light matrices in the block
+//
+//	layout(std140) uniform ShadowData { mat4 shadowMatrices[2]; vec4 shadowParams[2]; };
+//
+// which ShaderProgram::LinkProgram binds to ShadowBinding.
+class ShadowMaps
+{
+public:
+
+	static const int Resolution = 1024;
+
+	static const GLuint ShadowBinding = 2;
+
+	// one unit per view, right below the bone palette
+	static const GLuint FirstTextureUnit = BoneTexture::TextureUnit - RenderPacket::MaxShadowViews;
+
+	// layout must match the GLSL block above
+	struct ShadowData
+	{
+		mat4 Matrices[RenderPacket::MaxShadowViews];
+
+		// x: 1 if the view is used, y: depth bias, z: texel size
+		vec4 Params[RenderPacket::MaxShadowViews];
+	};
+
+	// number of times a static map was redrawn, for the render settings
+	static uint32_t StaticRebuilds;
+
+	static void Init();
+
+	// Draws the shadow maps of the packet and binds them with their ShadowData.
+	// Leaves the default framebuffer bound, the caller resets the viewport.
+	static void Render(const RenderPacket& packet);
+
+	// Forgets the cached static depth, call when a level is opened. Static keys are only
+	// unique within one level.
+	static void InvalidateStatic();
+
+private:
+
+	struct Slot
+	{
+		GLuint StaticTexture = 0;
+		GLuint StaticFramebuffer = 0;
+
+		GLuint Texture = 0;
+		GLuint Framebuffer = 0;
+
+		uint64_t StaticKey = 0;
+	};
+
+	static Slot slots[RenderPacket::MaxShadowViews];
+
+	static GLuint dataBuffer;
+
+	// bound to the units of unused views so the samplers always see a depth texture
+	static GLuint emptyTexture;
+
+	static GLuint CreateDepthTexture(int size, bool compare);
+	static GLuint CreateFramebuffer(GLuint depthTexture);
+
+	static Slot& GetSlot(int index);
+
+	static void DrawCasters(const RenderPacket& packet, const ShadowView& view, uint32_t start, uint32_t count);
+
+};
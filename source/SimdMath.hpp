@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+
+// Minimal 4-wide float vector used by the batched culling code.
+// SSE on desktop, SIMD128 on the web (needs -msimd128), plain floats otherwise.
+
+#if defined(__wasm_simd128__)
+#define SIMD_WASM 1
+#include <wasm_simd128.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SIMD_SSE 1
+#include <xmmintrin.h>
+#else
+#define SIMD_SCALAR 1
+#endif
+
+namespace simd
+{
+
+#if SIMD_WASM
+
+	struct float4 { v128_t v; };
+
+	inline float4 Load(const float* p) { return { wasm_v128_load(p) }; }
+	inline float4 Splat(float x) { return { wasm_f32x4_splat(x) }; }
+
+	inline float4 Add(float4 a, float4 b) { return { wasm_f32x4_add(a.v, b.v) }; }
+	inline float4 Sub(float4 a, float4 b) { return { wasm_f32x4_sub(a.v, b.v) }; }
+	inline float4 Mul(float4 a, float4 b) { return { wasm_f32x4_mul(a.v, b.v) }; }
+	inline float4 Neg(float4 a) { return { wasm_f32x4_neg(a.v) }; }
+
+	inline float4 Less(float4 a, float4 b) { return { wasm_f32x4_lt(a.v, b.v) }; }
+	inline float4 Or(float4 a, float4 b) { return { wasm_v128_or(a.v, b.v) }; }
+	inline float4 And(float4 a, float4 b) { return { wasm_v128_and(a.v, b.v) }; }
+
+	// one bit per lane, set where the lane's mask is true
+	inline int MoveMask(float4 a) { return (int)wasm_i32x4_bitmask(a.v); }
+
+	inline void Store(float* p, float4 a) { wasm_v128_store(p, a.v); }
+
+	inline float4 Min(float4 a, float4 b) { return { wasm_f32x4_pmin(a.v, b.v) }; }
+	inline float4 Max(float4 a, float4 b) { return { wasm_f32x4_pmax(a.v, b.v) }; }
+
+	// lanes of a where mask is true, of b elsewhere
+	inline float4 Select(float4 mask, float4 a, float4 b) { return { wasm_v128_bitselect(a.v, b.v, mask.v) }; }
+
+#elif SIMD_SSE
+
+	struct float4 { __m128 v; };
+
+	inline float4 Load(const float* p) { return { _mm_loadu_ps(p) }; }
+	inline float4 Splat(float x) { return { _mm_set1_ps(x) }; }
+
+	inline float4 Add(float4 a, float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline float4 Sub(float4 a, float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline float4 Mul(float4 a, float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+	inline float4 Neg(float4 a) { return { _mm_sub_ps(_mm_setzero_ps(), a.v) }; }
+
+	inline float4 Less(float4 a, float4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+	inline float4 Or(float4 a, float4 b) { return { _mm_or_ps(a.v, b.v) }; }
+	inline float4 And(float4 a, float4 b) { return { _mm_and_ps(a.v, b.v) }; }
+
+	inline int MoveMask(float4 a) { return _mm_movemask_ps(a.v); }
+
+	inline void Store(float* p, float4 a) { _mm_storeu_ps(p, a.v); }
+
+	inline float4 Min(float4 a, float4 b) { return { _mm_min_ps(a.v, b.v) }; }
+	inline float4 Max(float4 a, float4 b) { return { _mm_max_ps(a.v, b.v) }; }
+
+	inline float4 Select(float4 mask, float4 a, float4 b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+
+#else
+
+	struct float4 { float v[4]; };
+
+	inline float4 Load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+	inline float4 Splat(float x) { return { { x, x, x, x } }; }
+
+	inline float4 Add(float4 a, float4 b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+	inline float4 Sub(float4 a, float4 b) { return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+	inline float4 Mul(float4 a, float4 b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+	inline float4 Neg(float4 a) { return { { -a.v[0], -a.v[1], -a.v[2], -a.v[3] } }; }
+
+	// masks are stored as 1.0f / 0.0f per lane
+	inline float4 Less(float4 a, float4 b) { return { { a.v[0] < b.v[0] ? 1.0f : 0.0f, a.v[1] < b.v[1] ? 1.0f : 0.0f, a.v[2] < b.v[2] ? 1.0f : 0.0f, a.v[3] < b.v[3] ? 1.0f : 0.0f } }; }
+	inline float4 Or(float4 a, float4 b) { return { { (a.v[0] + b.v[0]) > 0 ? 1.0f : 0.0f, (a.v[1] + b.v[1]) > 0 ? 1.0f : 0.0f, (a.v[2] + b.v[2]) > 0 ? 1.0f : 0.0f, (a.v[3] + b.v[3]) > 0 ? 1.0f : 0.0f } }; }
+	inline float4 And(float4 a, float4 b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+
+	inline int MoveMask(float4 a) { return (a.v[0] > 0 ? 1 : 0) | (a.v[1] > 0 ? 2 : 0) | (a.v[2] > 0 ? 4 : 0) | (a.v[3] > 0 ? 8 : 0); }
+
+	inline void Store(float* p, float4 a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+
+	inline float4 Min(float4 a, float4 b) { return { { a.v[0] < b.v[0] ? a.v[0] : b.v[0], a.v[1] < b.v[1] ? a.v[1] : b.v[1], a.v[2] < b.v[2] ? a.v[2] : b.v[2], a.v[3] < b.v[3] ? a.v[3] : b.v[3] } }; }
+	inline float4 Max(float4 a, float4 b) { return { { a.v[0] > b.v[0] ? a.v[0] : b.v[0], a.v[1] > b.v[1] ? a.v[1] : b.v[1], a.v[2] > b.v[2] ? a.v[2] : b.v[2], a.v[3] > b.v[3] ? a.v[3] : b.v[3] } }; }
+
+	inline float4 Select(float4 mask, float4 a, float4 b) { return { { mask.v[0] > 0 ? a.v[0] : b.v[0], mask.v[1] > 0 ? a.v[1] : b.v[1], mask.v[2] > 0 ? a.v[2] : b.v[2], mask.v[3] > 0 ? a.v[3] : b.v[3] } }; }
+
+#endif
+
+	// a * b + c
+	inline float4 MulAdd(float4 a, float4 b, float4 c) { return Add(Mul(a, b), c); }
+
+}
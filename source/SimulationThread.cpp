@@ -0,0 +1,116 @@
+#include "SimulationThread.h"
+
+#include "Profiler.h"
+
+void SimulationThread::Start(std::function<void()> tickFunction, bool runThreaded)
+{
+	tick = tickFunction;
+
+#ifdef DISABLE_TREADPOOL
+	threaded = false;
+#else
+	threaded = runThreaded;
+
+	if (threaded)
+	{
+		shouldTerminate = false;
+		thread = std::thread(&SimulationThread::ThreadLoop, this);
+	}
+#endif // DISABLE_TREADPOOL
+}
+
+void SimulationThread::Stop()
+{
+#ifndef DISABLE_TREADPOOL
+
+	if (thread.joinable() == false)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		shouldTerminate = true;
+	}
+	condition.notify_all();
+
+	thread.join();
+
+#endif // !DISABLE_TREADPOOL
+}
+
+void SimulationThread::Kick()
+{
+
+#ifndef DISABLE_TREADPOOL
+
+	if (threaded)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			tickRequested = true;
+		}
+		condition.notify_all();
+		return;
+	}
+
+#endif // !DISABLE_TREADPOOL
+
+	RunTick();
+}
+
+void SimulationThread::Wait()
+{
+#ifndef DISABLE_TREADPOOL
+
+	if (threaded == false)
+		return;
+
+	std::unique_lock<std::mutex> guard(lock);
+	condition.wait(guard, [this] {
+		return !tickRequested && !tickRunning;
+		});
+
+#endif // !DISABLE_TREADPOOL
+}
+
+void SimulationThread::RunTick()
+{
+	GetWriteSnapshot().Frame = ++frame;
+
+	tick();
+
+	// publish: the slot just written becomes the one render reads from
+	readIndex.store(1 - readIndex.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+#ifndef DISABLE_TREADPOOL
+
+void SimulationThread::ThreadLoop()
+{
+	PROFILE_THREAD("Simulation");
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			condition.wait(guard, [this] {
+				return tickRequested || shouldTerminate;
+				});
+
+			if (shouldTerminate)
+				return;
+
+			tickRequested = false;
+			tickRunning = true;
+		}
+
+		RunTick();
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			tickRunning = false;
+		}
+		condition.notify_all();
+	}
+}
+
+#endif // !DISABLE_TREADPOOL
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include "JobScheduler.h"
+
+#ifndef DISABLE_TREADPOOL
+#include <condition_variable>
+#include <thread>
+#endif // !DISABLE_TREADPOOL
+
+#include "glm.h"
+#include "Camera.h"
+#include "FrustrumCull.hpp"
+
+// Everything the render side needs from one simulation tick. The simulation writes one
+// slot while the main thread renders from the other, so render never reads live Camera statics.
+struct FrameSnapshot
+{
+	uint64_t Frame = 0;
+
+	mat4 View = mat4(1.0f);
+	mat4 Projection = mat4(1.0f);
+	mat4 ProjectionViewmodel = mat4(1.0f);
+
+	vec3 CameraPosition = vec3(0.0f);
+	vec3 CameraRotation = vec3(0.0f);
+
+	Frustum CameraFrustum = Frustum(mat4(1.0f));
+
+	// Copies the camera state finalized by Camera::Update.
+	void CaptureCamera()
+	{
+		View = Camera::finalizedView;
+		Projection = Camera::finalizedProjection;
+		ProjectionViewmodel = Camera::finalizedProjectionViewmodel;
+
+		CameraPosition = Camera::finalizedPosition;
+		CameraRotation = Camera::finalizedRotation;
+
+		CameraFrustum = Camera::frustum;
+	}
+};
+
+// Long-lived thread that runs one simulation tick per Kick. Frames are pipelined:
+// the tick for frame N+1 runs while the main thread renders the snapshot of frame N.
+class SimulationThread
+{
+public:
+
+	// 1 - the tick kicked in a frame has to finish before that frame is presented.
+	// 2 - the tick may keep running through present and is waited for at the start of the next frame.
+	int PipelineDepth = 1;
+
+	void Start(std::function<void()> tickFunction, bool threaded);
+	void Stop();
+
+	// Starts the next tick. The previous one must have been waited for.
+	void Kick();
+
+	// Blocks until the in-flight tick (if any) has finished and published its snapshot.
+	void Wait();
+
+	bool IsThreaded() const { return threaded; }
+
+	// Slot the running tick writes into. Only valid from inside the tick.
+	FrameSnapshot& GetWriteSnapshot()
+	{
+		return snapshots[1 - readIndex.load(std::memory_order_relaxed)];
+	}
+
+	// Snapshot of the last finished tick. Stays valid until the next Kick.
+	const FrameSnapshot& GetReadSnapshot() const
+	{
+		return snapshots[readIndex.load(std::memory_order_acquire)];
+	}
+
+private:
+
+	void RunTick();
+
+	std::function<void()> tick;
+
+	bool threaded = false;
+
+	FrameSnapshot snapshots[2];
+	std::atomic<int> readIndex = 0;
+	uint64_t frame = 0;
+
+#ifndef DISABLE_TREADPOOL
+
+	void ThreadLoop();
+
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable condition;
+
+	bool tickRequested = false;
+	bool tickRunning = false;
+	bool shouldTerminate = false;
+
+#endif // !DISABLE_TREADPOOL
+
+};
@@ -69,7 +69,10 @@ private:
 
 	std::vector<mat4> boneTransforms;
 
-	std::vector<mat4> finalizedBoneTransforms;
+	// packet the bones were last added to and where, shadow views reuse the camera pass's range
+	uint64_t paletteFrame = 0;
+	uint32_t paletteOffset = 0;
+	uint32_t paletteCount = 0;
 
 	double blendStartTime = 0;
 	double blendEndTime = 0;
@@ -94,16 +97,13 @@ private:
 	}
 	AnimationPose blendStartPose;
 
-protected:
+public:
 
-	void ApplyAdditionalShaderParams(ShaderProgram* shader_program)
+	bool CanStaticBatch()
 	{
-		for (int i = 0; i < finalizedBoneTransforms.size(); ++i)
-			shader_program->SetUniform("finalBonesMatrices[" + std::to_string(i) + "]", finalizedBoneTransforms[i]);
+		return false;
 	}
 
-public:
-
 	AnimationPose GetAnimationPose()
 	{
 
@@ -125,10 +125,24 @@ public:
 		PlayAnimation(interpIn);
 	}
 
-	void FinalizeFrameData()
+	// Bone matrices go to the packet's palette, the draw reads them from BoneTexture.
+	// Only draws of the packet the texture was uploaded from are skinned correctly.
+	// The bones are added once per packet however many passes draw the mesh.
+	void FinalizeFrameData(RenderItem& item, RenderPacket& packet)
 	{
-		StaticMesh::FinalizeFrameData();
-		finalizedBoneTransforms = boneTransforms;
+		StaticMesh::FinalizeFrameData(item, packet);
+
+		if (paletteFrame != packet.Frame)
+		{
+			paletteFrame = packet.Frame;
+			paletteOffset = static_cast<uint32_t>(packet.BonePalette.size());
+			paletteCount = static_cast<uint32_t>(boneTransforms.size());
+
+			packet.BonePalette.insert(packet.BonePalette.end(), boneTransforms.begin(), boneTransforms.end());
+		}
+
+		item.BoneOffset = paletteOffset;
+		item.BoneCount = paletteCount;
 	}
 
 	void PlayAnimation(float interpIn = 0.12)
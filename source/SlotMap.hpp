@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Reference into a SlotMap. The generation changes every time a slot is reused,
+// so a handle kept after its value was removed is detected as stale instead of
+// silently pointing at whatever took the slot.
+struct SlotHandle
+{
+	static constexpr uint32_t InvalidIndex = 0xFFFFFFFF;
+
+	uint32_t Index = InvalidIndex;
+	uint32_t Generation = 0;
+
+	bool IsValid() const { return Index != InvalidIndex; }
+
+	bool operator==(const SlotHandle& other) const { return Index == other.Index && Generation == other.Generation; }
+	bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+};
+
+// Values live densely packed in insertion order (until removals swap the last one in),
+// handles go through a slot array. Insert, Remove and Get are O(1).
+template<typename T>
+class SlotMap
+{
+public:
+
+	SlotHandle Insert(const T& value)
+	{
+		uint32_t slotIndex;
+
+		if (freeHead != SlotHandle::InvalidIndex)
+		{
+			slotIndex = freeHead;
+			freeHead = slots[slotIndex].DenseIndex;
+		}
+		else
+		{
+			slotIndex = (uint32_t)slots.size();
+			slots.push_back(Slot());
+		}
+
+		Slot& slot = slots[slotIndex];
+		slot.DenseIndex = (uint32_t)values.size();
+
+		values.push_back(value);
+		denseToSlot.push_back(slotIndex);
+
+		return SlotHandle{ slotIndex, slot.Generation };
+	}
+
+	// Returns false if the handle was already stale.
+	bool Remove(SlotHandle handle)
+	{
+		if (Contains(handle) == false)
+			return false;
+
+		Slot& slot = slots[handle.Index];
+
+		uint32_t dense = slot.DenseIndex;
+		uint32_t last = (uint32_t)values.size() - 1;
+
+		if (dense != last)
+		{
+			values[dense] = std::move(values[last]);
+			denseToSlot[dense] = denseToSlot[last];
+			slots[denseToSlot[dense]].DenseIndex = dense;
+		}
+
+		values.pop_back();
+		denseToSlot.pop_back();
+
+		slot.Generation++;
+		slot.DenseIndex = freeHead;
+		freeHead = handle.Index;
+
+		return true;
+	}
+
+	bool Contains(SlotHandle handle) const
+	{
+		return handle.Index < slots.size() && slots[handle.Index].Generation == handle.Generation;
+	}
+
+	// nullptr if the handle is stale
+	T* Get(SlotHandle handle)
+	{
+		if (Contains(handle) == false)
+			return nullptr;
+
+		return &values[slots[handle.Index].DenseIndex];
+	}
+
+	const T* Get(SlotHandle handle) const
+	{
+		if (Contains(handle) == false)
+			return nullptr;
+
+		return &values[slots[handle.Index].DenseIndex];
+	}
+
+	// Handle of the value at a dense position, for iteration that needs to remove.
+	SlotHandle HandleAt(uint32_t denseIndex) const
+	{
+		uint32_t slotIndex = denseToSlot[denseIndex];
+		return SlotHandle{ slotIndex, slots[slotIndex].Generation };
+	}
+
+	// Removes every value. Outstanding handles become stale.
+	void Clear()
+	{
+		for (uint32_t slotIndex : denseToSlot)
+		{
+			Slot& slot = slots[slotIndex];
+			slot.Generation++;
+			slot.DenseIndex = freeHead;
+			freeHead = slotIndex;
+		}
+
+		values.clear();
+		denseToSlot.clear();
+	}
+
+	size_t size() const { return values.size(); }
+	bool empty() const { return values.empty(); }
+
+	T& operator[](size_t denseIndex) { return values[denseIndex]; }
+	const T& operator[](size_t denseIndex) const { return values[denseIndex]; }
+
+	typename std::vector<T>::iterator begin() { return values.begin(); }
+	typename std::vector<T>::iterator end() { return values.end(); }
+	typename std::vector<T>::const_iterator begin() const { return values.begin(); }
+	typename std::vector<T>::const_iterator end() const { return values.end(); }
+
+private:
+
+	struct Slot
+	{
+		// position in values while used, next free slot while free
+		uint32_t DenseIndex = SlotHandle::InvalidIndex;
+		uint32_t Generation = 0;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<T> values;
+	std::vector<uint32_t> denseToSlot;
+
+	uint32_t freeHead = SlotHandle::InvalidIndex;
+
+};
@@ -0,0 +1,339 @@
+#include "StaticBatch.h"
+
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+#include "StaticMesh.hpp"
+#include "ShaderManager.h"
+#include "UniformBuffers.h"
+#include "RenderSort.hpp"
+#include "MeshOptimizer.h"
+#include "AssetRegisty.h"
+#include "Logger.hpp"
+
+bool StaticBatch::Enabled = true;
+
+void StaticBatchCell::Init()
+{
+	shaderSortId = RenderSort::HashName(PixelShader);
+
+	forwardProgram = ShaderManager::ReserveShaderProgram("skeletal", PixelShader);
+	depthProgram = ShaderManager::ReserveShaderProgram("skeletal", "empty_pixel");
+
+	// cells of a material were packed next to each other, sorting them together keeps the page's VAO bound
+	materialSortId = RenderSort::HashId((uintptr_t)VAO * 31 + (uintptr_t)ColorTexture + std::hash<string>()(TexturePath));
+}
+
+void StaticBatchCell::FinalizeFrameData(RenderItem& item, RenderPacket& packet)
+{
+	item.World = mat4(1.0f);
+	item.ColorTexture = ColorTexture;
+	item.Program = forwardProgram;
+	item.ShaderId = shaderSortId;
+	item.MaterialId = materialSortId;
+}
+
+void StaticBatchCell::Draw(const RenderItem& item) const
+{
+	UniformBuffers::BindObject(item);
+
+	VAO->Bind();
+
+	size_t indexSize = VAO->IndexType == GL_UNSIGNED_SHORT ? 2 : 4;
+
+	glDrawElements(GL_TRIANGLES, IndexCount, VAO->IndexType, (void*)(IndexStart * indexSize));
+}
+
+void StaticBatchCell::DrawForward(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection)
+{
+	ShaderProgram* shader_program = ShaderManager::Prepare(item.Program);
+
+	if (item.ColorTexture == nullptr && cachedTexture == nullptr)
+		cachedTexture = AssetRegistry::GetTextureFromFile(TexturePath);
+
+	shader_program->UseProgram();
+	shader_program->SetTexture("u_texture", item.ColorTexture ? item.ColorTexture : cachedTexture);
+
+	Draw(item);
+}
+
+void StaticBatchCell::DrawDepth(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection)
+{
+	ShaderManager::Prepare(depthProgram)->UseProgram();
+
+	Draw(item);
+}
+
+void StaticBatchCell::DrawShadow(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection)
+{
+	ShaderManager::Prepare(depthProgram)->UseProgram();
+
+	Draw(item);
+}
+
+namespace
+{
+	// everything that has to match for triangles to share a draw, then the cell
+	struct GroupKey
+	{
+		string PixelShader;
+		Texture* ColorTexture;
+		string TexturePath;
+		bool CastShadows;
+		bool Occluder;
+		ivec3 Cell;
+
+		bool operator<(const GroupKey& other) const
+		{
+			return std::tie(PixelShader, ColorTexture, TexturePath, CastShadows, Occluder, Cell.x, Cell.y, Cell.z) <
+				std::tie(other.PixelShader, other.ColorTexture, other.TexturePath, other.CastShadows, other.Occluder, other.Cell.x, other.Cell.y, other.Cell.z);
+		}
+	};
+
+	struct Group
+	{
+		vector<VertexData> Vertices;
+		vector<uint32_t> Indices;
+	};
+
+	string GetBaseTexturePath(const roj::SkinnedMesh& mesh)
+	{
+		for (const auto& texture : mesh.textures)
+		{
+			if (texture.type == aiTextureType_BASE_COLOR)
+				return "GameData/Textures/" + texture.src;
+		}
+
+		return "GameData/Textures/";
+	}
+
+	VertexData ToWorld(const VertexData& vertex, const mat4& world, const mat3& normalMatrix)
+	{
+		VertexData result = vertex;
+
+		result.Position = vec3(world * vec4(vertex.Position, 1.0f));
+
+		auto transformDirection = [](const mat3& matrix, const vec3& direction)
+			{
+				vec3 transformed = matrix * direction;
+				float length = glm::length(transformed);
+				return length > 0 ? transformed / length : transformed;
+			};
+
+		result.Normal = transformDirection(normalMatrix, vertex.Normal);
+		result.SmoothNormal = transformDirection(normalMatrix, vertex.SmoothNormal);
+		result.Tangent = transformDirection(mat3(world), vertex.Tangent);
+		result.BiTangent = transformDirection(mat3(world), vertex.BiTangent);
+
+		return result;
+	}
+}
+
+StaticBatch* StaticBatch::Build(const vector<LevelObject*>& objects)
+{
+	if (Enabled == false)
+		return nullptr;
+
+	map<GroupKey, Group> groups;
+
+	Stats stats;
+
+	// group vertex of every source vertex, per group the current mesh touched
+	unordered_map<Group*, vector<uint32_t>> remaps;
+
+	for (LevelObject* object : objects)
+	{
+		if (object->Static == false)
+			continue;
+
+		for (IDrawMesh* drawMesh : object->GetDrawMeshes())
+		{
+			StaticMesh* staticMesh = dynamic_cast<StaticMesh*>(drawMesh);
+
+			if (staticMesh == nullptr || drawMesh->StaticBatched || staticMesh->CanStaticBatch() == false)
+				continue;
+
+			mat4 world = staticMesh->GetWorldMatrix();
+			mat3 normalMatrix = transpose(inverse(mat3(world)));
+
+			bool occluder = staticMesh->IsOccluder();
+
+			for (const roj::SkinnedMesh& mesh : staticMesh->model->meshes)
+			{
+				vector<VertexData> worldVertices;
+				worldVertices.reserve(mesh.vertexLocations.size());
+
+				for (const VertexData& vertex : mesh.vertexLocations)
+					worldVertices.push_back(ToWorld(vertex, world, normalMatrix));
+
+				GroupKey key;
+				key.PixelShader = staticMesh->GetPixelShader();
+				key.ColorTexture = staticMesh->ColorTexture;
+				key.TexturePath = staticMesh->ColorTexture ? "" : GetBaseTexturePath(mesh);
+				key.CastShadows = staticMesh->CastShadows;
+				key.Occluder = occluder;
+
+				remaps.clear();
+
+				size_t vertexCount = worldVertices.size();
+
+				for (size_t i = 0; i + 2 < mesh.vertexIndices.size(); i += 3)
+				{
+					const uint32_t* triangle = &mesh.vertexIndices[i];
+
+					if (triangle[0] >= vertexCount || triangle[1] >= vertexCount || triangle[2] >= vertexCount)
+						continue;
+
+					vec3 centroid = (worldVertices[triangle[0]].Position + worldVertices[triangle[1]].Position + worldVertices[triangle[2]].Position) / 3.0f;
+					key.Cell = ivec3(floor(centroid / CellSize));
+
+					Group& group = groups[key];
+
+					vector<uint32_t>& remap = remaps[&group];
+					if (remap.empty())
+						remap.resize(vertexCount, ~0u);
+
+					for (int k = 0; k < 3; k++)
+					{
+						uint32_t& index = remap[triangle[k]];
+
+						if (index == ~0u)
+						{
+							index = (uint32_t)group.Vertices.size();
+							group.Vertices.push_back(worldVertices[triangle[k]]);
+						}
+
+						group.Indices.push_back(index);
+					}
+				}
+			}
+
+			drawMesh->StaticBatched = true;
+			stats.SourceMeshes++;
+		}
+	}
+
+	if (groups.empty())
+		return nullptr;
+
+	StaticBatch* batch = new StaticBatch();
+
+	// pages fill in group order, so a material's cells share as few pages as possible
+	vector<VertexData> pageVertices;
+	vector<uint32_t> pageIndices;
+	vector<StaticBatchCell*> pageCells;
+
+	auto flushPage = [&]()
+		{
+			if (pageCells.empty())
+				return;
+
+			Page page;
+			page.Vertices = CreatePackedVertexBuffer(pageVertices, false);
+			page.Indices = new IndexBuffer(pageIndices);
+			page.VAO = new VertexArrayObject(*page.Vertices, *page.Indices);
+
+			for (StaticBatchCell* cell : pageCells)
+			{
+				cell->VAO = page.VAO;
+				cell->Init();
+			}
+
+			batch->pages.push_back(page);
+
+			pageVertices.clear();
+			pageIndices.clear();
+			pageCells.clear();
+		};
+
+	for (auto& entry : groups)
+	{
+		const GroupKey& key = entry.first;
+		Group& group = entry.second;
+
+		if (group.Indices.empty())
+			continue;
+
+		if (roj::LoaderGlobalParams::OptimizeMeshes)
+		{
+			MeshOptimizer::OptimizeVertexCache(group.Indices, group.Vertices.size());
+			MeshOptimizer::OptimizeVertexFetch(group.Vertices, group.Indices);
+		}
+
+		// an oversized group gets a page of its own with 32-bit indices
+		if (pageVertices.size() + group.Vertices.size() > MaxPageVertices)
+			flushPage();
+
+		StaticBatchCell* cell = new StaticBatchCell();
+		cell->PixelShader = key.PixelShader;
+		cell->ColorTexture = key.ColorTexture;
+		cell->TexturePath = key.TexturePath;
+		cell->CastShadows = key.CastShadows;
+		cell->StaticNavigation = false;
+
+		cell->IndexStart = (uint32_t)pageIndices.size();
+		cell->IndexCount = (uint32_t)group.Indices.size();
+
+		uint32_t baseVertex = (uint32_t)pageVertices.size();
+
+		for (uint32_t index : group.Indices)
+			pageIndices.push_back(baseVertex + index);
+
+		vec3 min = vec3(FLT_MAX);
+		vec3 max = vec3(-FLT_MAX);
+
+		for (const VertexData& vertex : group.Vertices)
+		{
+			min = glm::min(min, vertex.Position);
+			max = glm::max(max, vertex.Position);
+		}
+
+		cell->Bounds.Min = min;
+		cell->Bounds.Max = max;
+		cell->Bounds.Center = (min + max) * 0.5f;
+		cell->Bounds.Radius = length(max - min) * 0.5f;
+
+		if (key.Occluder)
+		{
+			cell->OccluderTriangles.reserve(group.Indices.size());
+
+			for (uint32_t index : group.Indices)
+				cell->OccluderTriangles.push_back(group.Vertices[index].Position);
+		}
+
+		pageVertices.insert(pageVertices.end(), group.Vertices.begin(), group.Vertices.end());
+
+		pageCells.push_back(cell);
+		batch->Drawables.push_back(cell);
+
+		stats.Cells++;
+		stats.Triangles += (uint32_t)group.Indices.size() / 3;
+	}
+
+	flushPage();
+
+	stats.Pages = (uint32_t)batch->pages.size();
+	batch->Current = stats;
+
+	Logger::Log("static batch: " + to_string(stats.SourceMeshes) + " meshes into " + to_string(stats.Cells) + " cells on " +
+		to_string(stats.Pages) + " pages, " + to_string(stats.Triangles) + " triangles");
+
+	return batch;
+}
+
+void StaticBatch::Destroy()
+{
+	Entity::Destroy();
+
+	for (Page& page : pages)
+	{
+		delete(page.VAO);
+		delete(page.Vertices);
+		delete(page.Indices);
+	}
+
+	pages.clear();
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "glm.h"
+
+#include "Entity.hpp"
+#include "IDrawMesh.h"
+#include "ShaderManager.h"
+#include "VertexData.h"
+#include "Texture.hpp"
+
+class LevelObject;
+
+// Geometry of one material inside one grid cell of the level, drawn as an index range of
+// its page's shared buffers.
+class StaticBatchCell : public IDrawMesh
+{
+private:
+
+	uint16_t shaderSortId;
+	uint16_t materialSortId;
+
+	// resolved on the render thread like StaticMesh does for model textures
+	Texture* cachedTexture = nullptr;
+
+	// reserved in Init, the render thread Prepares them
+	ShaderProgram* forwardProgram = nullptr;
+	ShaderProgram* depthProgram = nullptr;
+
+	// with the pass's shader program in use
+	void Draw(const RenderItem& item) const;
+
+public:
+
+	VertexArrayObject* VAO = nullptr;
+
+	uint32_t IndexStart = 0;
+	uint32_t IndexCount = 0;
+
+	string PixelShader;
+
+	// set for meshes with a ColorTexture, otherwise TexturePath is loaded on first draw
+	Texture* ColorTexture = nullptr;
+	string TexturePath;
+
+	WorldBounds Bounds;
+
+	// world space triangles, empty if the cell's meshes were not occluders
+	vector<vec3> OccluderTriangles;
+
+	void Init();
+
+	float GetDistanceToCamera()
+	{
+		return distance(Camera::position, Bounds.Center);
+	}
+
+	bool GetWorldBounds(WorldBounds& bounds)
+	{
+		bounds = Bounds;
+		return true;
+	}
+
+	bool IsOccluder()
+	{
+		return OccluderTriangles.empty() == false;
+	}
+
+	const vector<vec3>* GetOccluderTriangles()
+	{
+		return OccluderTriangles.empty() ? nullptr : &OccluderTriangles;
+	}
+
+	void GetShaderPrograms(vector<ShaderManager::ProgramName>& programs)
+	{
+		programs.push_back({ "skeletal", PixelShader });
+		programs.push_back({ "skeletal", "empty_pixel" });
+	}
+
+	void FinalizeFrameData(RenderItem& item, RenderPacket& packet);
+
+	void DrawForward(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection);
+	void DrawDepth(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection);
+	void DrawShadow(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection);
+
+};
+
+// Level-wide batch of static geometry. At load the meshes of Static objects that allow it
+// (StaticMesh::CanStaticBatch) are baked into world space and split by material and by a
+// CellSize grid. Cells are packed, material by material, into a few pages of shared vertex
+// and index buffers small enough for 16-bit indices, so the world is drawn as index ranges
+// of a handful of VAOs and the cells are culled like any other static drawable.
+//
+// The source meshes stay with their objects for physics and navigation but are no longer
+// drawn. Geometry is baked once, removing a batched object later leaves it drawn.
+class StaticBatch : public Entity
+{
+private:
+
+	struct Page
+	{
+		VertexBuffer* Vertices = nullptr;
+		IndexBuffer* Indices = nullptr;
+		VertexArrayObject* VAO = nullptr;
+	};
+
+	vector<Page> pages;
+
+public:
+
+	static constexpr float CellSize = 32.0f;
+
+	// vertices 0..65534, so a full page stays clear of the 16-bit restart index 0xFFFF
+	static const uint32_t MaxPageVertices = 65535;
+
+	// read when a level is opened
+	static bool Enabled;
+
+	struct Stats
+	{
+		uint32_t SourceMeshes = 0;
+		uint32_t Cells = 0;
+		uint32_t Pages = 0;
+		uint32_t Triangles = 0;
+	};
+
+	Stats Current;
+
+	StaticBatch()
+	{
+		Static = true;
+		ClassName = "StaticBatch";
+	}
+
+	// Batches the eligible meshes of the objects, nullptr if there were none.
+	static StaticBatch* Build(const vector<LevelObject*>& objects);
+
+	void Destroy();
+
+};
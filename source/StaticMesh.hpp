@@ -14,6 +14,12 @@
 
 #include "glm.h"
 
+#include "RenderSort.hpp"
+
+#include "InstanceBuffer.h"
+
+#include <typeinfo>
+
 
 using namespace std;
 
@@ -21,18 +27,64 @@ class StaticMesh : public IDrawMesh
 {
 private:
 
-	mat4 finalizedWorld;
+	// transform the bounds table row was last written with
+	vec3 boundsPosition = vec3(0);
+	vec3 boundsRotation = vec3(0);
+	vec3 boundsScale = vec3(1);
+	roj::SkinnedModel* boundsModel = nullptr;
+
+	uint16_t pixelShaderSortId = RenderSort::InvalidShaderId;
+
+	// LOD picked last frame, simulation thread only
+	int currentLod = 0;
 
 protected:
 
-	virtual void ApplyAdditionalShaderParams(ShaderProgram* shader_program)
+	virtual void ApplyAdditionalShaderParams(ShaderProgram* shader_program, const RenderItem& item, const RenderPacket& packet)
 	{
 
 	}
 
 	string PixelShader = "default_pixel";
 
+	// reserved on the game thread in FinalizeFrameData, draws use the copies in RenderItem
 	ShaderProgram* forward_shader_program = nullptr;
+	ShaderProgram* instanced_shader_program = nullptr;
+
+	void BindMeshTexture(ShaderProgram* shader_program, roj::SkinnedMesh& mesh, const RenderItem& item)
+	{
+		if (item.ColorTexture == nullptr)
+		{
+
+			string baseTextureName;
+
+			for (auto texture : mesh.textures)
+			{
+				if (texture.type == aiTextureType_BASE_COLOR)
+				{
+					baseTextureName = texture.src;
+					break;
+				}
+			}
+		
+				
+				
+			if (mesh.cachedBaseColor == nullptr)
+			{
+				const string textureRoot = "GameData/Textures/";
+
+				mesh.cachedBaseColor = AssetRegistry::GetTextureFromFile(textureRoot + baseTextureName);
+			}
+
+			Texture* texture = mesh.cachedBaseColor;
+
+			shader_program->SetTexture("u_texture", texture);
+		}
+		else
+		{
+			shader_program->SetTexture("u_texture", item.ColorTexture);
+		}
+	}
 
 public:
 
@@ -42,6 +94,15 @@ public:
 
 	Texture* ColorTexture = nullptr;
 
+	// Screen size below which LOD i + 1 replaces LOD i, one entry per generated LOD.
+	static constexpr float LodScreenSizes[3] = { 0.4f, 0.2f, 0.1f };
+
+	// how far past a threshold the screen size has to go before the LOD changes, against popping
+	static constexpr float LodHysteresis = 0.15f;
+
+	// scales the screen size used for LOD selection, above 1 keeps detail longer
+	float LodBias = 1;
+
 	vec3 Position = vec3(0);
 	vec3 Rotation = vec3(0);
 	vec3 Scale = vec3(1);
@@ -55,11 +116,33 @@ public:
 
 	}
 
+	const string& GetPixelShader() const
+	{
+		return PixelShader;
+	}
+
+	// Whether StaticBatch may bake this mesh into level geometry. Subclasses that set shader
+	// parameters of their own or change the model per frame should return false.
+	virtual bool CanStaticBatch()
+	{
+		return AllowStaticBatch && model != nullptr && Transparent == false && IsViewmodel == false &&
+			model->boneCount == 0 && model->lodCount == 1;
+	}
+
+	void GetShaderPrograms(vector<ShaderManager::ProgramName>& programs)
+	{
+		programs.push_back({ "skeletal", PixelShader });
+		programs.push_back({ "skeletal_instanced", PixelShader });
+		programs.push_back({ "skeletal", "empty_pixel" });
+	}
+
 	void SetPixelShader(string name)
 	{
 		PixelShader = name;
 
 		forward_shader_program = nullptr;
+		instanced_shader_program = nullptr;
+		pixelShaderSortId = RenderSort::InvalidShaderId;
 
 	}
 
@@ -101,9 +184,47 @@ public:
 		return distance(Camera::position, Position) * (IsViewmodel ? 0.1 : 1);
 	}
 
-	void FinalizeFrameData()
+	int SelectLod(float screenSize)
 	{
-		finalizedWorld = GetWorldMatrix();
+		int maxLod = model ? std::min(model->lodCount - 1, (int)std::size(LodScreenSizes)) : 0;
+
+		currentLod = std::min(currentLod, maxLod);
+
+		screenSize *= LodBias;
+
+		while (currentLod > 0 && screenSize > LodScreenSizes[currentLod - 1] * (1 + LodHysteresis))
+			currentLod--;
+
+		while (currentLod < maxLod && screenSize < LodScreenSizes[currentLod] * (1 - LodHysteresis))
+			currentLod++;
+
+		return currentLod;
+	}
+
+	void FinalizeFrameData(RenderItem& item, RenderPacket& packet)
+	{
+		item.World = GetWorldMatrix();
+		item.Model = model;
+		item.ColorTexture = ColorTexture;
+		item.Lod = item.IsViewmodel ? 0 : (uint8_t)SelectLod(item.ScreenSize);
+
+		if (pixelShaderSortId == RenderSort::InvalidShaderId)
+			pixelShaderSortId = RenderSort::HashName(PixelShader);
+
+		// picked here with the rest of the frame's state, SetPixelShader runs on this thread too
+		if (forward_shader_program == nullptr)
+		{
+			forward_shader_program = ShaderManager::ReserveShaderProgram("skeletal", PixelShader);
+			instanced_shader_program = ShaderManager::ReserveShaderProgram("skeletal_instanced", PixelShader);
+		}
+
+		item.Program = forward_shader_program;
+		item.InstancedProgram = instanced_shader_program;
+
+		item.ShaderId = pixelShaderSortId;
+
+		// the model is part of the material so draws of the same model sort next to each other and can be instanced
+		item.MaterialId = RenderSort::HashId(((uintptr_t)model * 31 + (ColorTexture ? ColorTexture->getID() : 0)) * 4 + item.Lod);
 	}
 
 
@@ -116,6 +237,35 @@ public:
 
 	}
 
+	bool GetWorldBounds(WorldBounds& bounds)
+	{
+		if (model == nullptr)
+			return false;
+
+		auto sphere = model->boundingSphere.Transform(Position, Rotation, Scale);
+
+		bounds.Center = sphere.offset;
+		bounds.Radius = sphere.Radius;
+		bounds.Min = sphere.offset - vec3(sphere.Radius);
+		bounds.Max = sphere.offset + vec3(sphere.Radius);
+
+		return true;
+	}
+
+	bool UpdateBounds(BoundsTable& table, uint32_t row)
+	{
+		if (Position != boundsPosition || Rotation != boundsRotation || Scale != boundsScale || model != boundsModel)
+		{
+			boundsPosition = Position;
+			boundsRotation = Rotation;
+			boundsScale = Scale;
+			boundsModel = model;
+			BoundsDirty = true;
+		}
+
+		return IDrawMesh::UpdateBounds(table, row);
+	}
+
 	bool IsInFrustrum(Frustum frustrum)
 	{
 
@@ -126,115 +276,112 @@ public:
 	
 
 
-	void DrawForward(mat4x4 view, mat4x4 projection)
+	void DrawForward(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection)
 	{
 
-		
-		if(forward_shader_program == nullptr)
-			forward_shader_program = ShaderManager::GetShaderProgram("skeletal", PixelShader);
+		ShaderProgram* shader_program = ShaderManager::Prepare(item.Program);
 
-		forward_shader_program->UseProgram();
+		shader_program->UseProgram();
 
+		// camera comes from the FrameData block of the pass, world and flags from ObjectData
+		UniformBuffers::BindObject(item);
 
-		mat4x4 world = finalizedWorld;
+		ApplyAdditionalShaderParams(shader_program, item, packet);
 
-		forward_shader_program->SetUniform("view", view);
-		forward_shader_program->SetUniform("projection", projection);
 
-		forward_shader_program->SetUniform("world", world);
+		for (roj::SkinnedMesh& mesh : item.Model->meshes)
+		{
+			BindMeshTexture(shader_program, mesh, item);
 
-		forward_shader_program->SetUniform("isViewmodel", IsViewmodel);
+			VertexArrayObject* vao = mesh.GetVAO(item.Lod);
 
-		ApplyAdditionalShaderParams(forward_shader_program);
+			vao->Bind();
+			glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(vao->IndexCount), vao->IndexType, 0);
+		}
 
 
-		for (roj::SkinnedMesh& mesh : model->meshes)
-		{
+	}
 
-			if (ColorTexture == nullptr)
-			{
+	// Same model, LOD, textures and pixel shader, and nothing skeletal.vert does per object
+	// that skeletal_instanced.vert doesn't.
+	bool CanInstanceWith(const RenderItem& item, const IDrawMesh& other, const RenderItem& otherItem) const
+	{
+		if (typeid(other) != typeid(*this))
+			return false;
+
+		if (item.Model == nullptr || item.IsViewmodel || item.Transparent || item.BoneCount > 0)
+			return false;
+
+		return otherItem.Model == item.Model &&
+			otherItem.ColorTexture == item.ColorTexture &&
+			otherItem.Lod == item.Lod &&
+			otherItem.IsViewmodel == item.IsViewmodel &&
+			otherItem.Transparent == item.Transparent &&
+			otherItem.BoneCount == 0 &&
+			otherItem.Program == item.Program;
+	}
 
-				string baseTextureName;
+	void DrawForwardInstanced(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection)
+	{
+		ShaderProgram* shader_program = ShaderManager::Prepare(item.InstancedProgram);
 
-				for (auto texture : mesh.textures)
-				{
-					if (texture.type == aiTextureType_BASE_COLOR)
-					{
-						baseTextureName = texture.src;
-						break;
-					}
-				}
-		
-				
-				
-				if (mesh.cachedBaseColor == nullptr)
-				{
-					const string textureRoot = "GameData/Textures/";
+		shader_program->UseProgram();
 
-					mesh.cachedBaseColor = AssetRegistry::GetTextureFromFile(textureRoot + baseTextureName);
-				}
+		ApplyAdditionalShaderParams(shader_program, item, packet);
 
-				Texture* texture = mesh.cachedBaseColor;
+		for (roj::SkinnedMesh& mesh : item.Model->meshes)
+		{
+			BindMeshTexture(shader_program, mesh, item);
 
-				forward_shader_program->SetTexture("u_texture", texture);
-			}
-			else
-			{
-				forward_shader_program->SetTexture("u_texture", ColorTexture);
-			}
+			VertexArrayObject* vao = mesh.GetVAO(item.Lod);
 
-			mesh.VAO->Bind();
-			glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(mesh.VAO->IndexCount), GL_UNSIGNED_INT, 0);
-		}
+			vao->Bind();
 
+			InstanceBuffer::BindInstances(item.InstanceOffset);
 
+			glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(vao->IndexCount), vao->IndexType, 0, item.InstanceCount);
+
+			InstanceBuffer::UnbindInstances();
+		}
 	}
 
-	void DrawDepth(mat4x4 view, mat4x4 projection)
+	void DrawDepth(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection)
 	{
 		ShaderProgram* shader_program = ShaderManager::GetShaderProgram("skeletal", "empty_pixel");
 
 		shader_program->UseProgram();
 
-		mat4x4 world = finalizedWorld;
-
-		shader_program->SetUniform("view", view);
-		shader_program->SetUniform("projection", projection);
+		UniformBuffers::BindObject(item);
 
-		shader_program->SetUniform("world", world);
+		ApplyAdditionalShaderParams(shader_program, item, packet);
 
-		shader_program->SetUniform("isViewmodel", IsViewmodel);
 
-		ApplyAdditionalShaderParams(shader_program);
-
-
-		for (const roj::SkinnedMesh& mesh : model->meshes)
+		for (const roj::SkinnedMesh& mesh : item.Model->meshes)
 		{
-			mesh.VAO->Bind();
-			glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(mesh.VAO->IndexCount), GL_UNSIGNED_INT, 0);
+			VertexArrayObject* vao = mesh.GetVAO(item.Lod);
+
+			vao->Bind();
+			glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(vao->IndexCount), vao->IndexType, 0);
 		}
 	}
 
-	void DrawShadow(mat4x4 view, mat4x4 projection)
+	void DrawShadow(const RenderItem& item, const RenderPacket& packet, mat4x4 view, mat4x4 projection)
 	{
 		ShaderProgram* shader_program = ShaderManager::GetShaderProgram("skeletal", "empty_pixel");
 
 		shader_program->UseProgram();
 
-		mat4x4 world = finalizedWorld;
+		UniformBuffers::BindObject(item);
 
-		shader_program->SetUniform("view", view);
-		shader_program->SetUniform("projection", projection);
+		ApplyAdditionalShaderParams(shader_program, item, packet);
 
-		shader_program->SetUniform("world", world);
 
-		ApplyAdditionalShaderParams(shader_program);
-
-
-		for (const roj::SkinnedMesh& mesh : model->meshes)
+		for (const roj::SkinnedMesh& mesh : item.Model->meshes)
 		{
-			mesh.VAO->Bind();
-			glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(mesh.VAO->IndexCount), GL_UNSIGNED_INT, 0);
+			VertexArrayObject* vao = mesh.GetVAO(item.Lod);
+
+			vao->Bind();
+			glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(vao->IndexCount), vao->IndexType, 0);
 		}
 	}
 
@@ -3,6 +3,7 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include "gl.h"
+#include "RenderState.h"
 #include <string>
 #include <iostream>
 
@@ -13,11 +14,12 @@ public:
     }
 
     ~Texture() {
+        RenderState::OnTextureDeleted(textureID);
         glDeleteTextures(1, &textureID);
     }
 
     void bind() const {
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        RenderState::BindTexture(GL_TEXTURE_2D, textureID);
     }
 
     bool valid = false;
@@ -44,7 +46,7 @@ private:
         }
 
         glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        RenderState::BindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, converted_surface->w, converted_surface->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, converted_surface->pixels);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generateMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
@@ -0,0 +1,253 @@
+#include "FontAtlas.h"
+
+#include "../RenderState.h"
+
+#include <algorithm>
+
+std::unordered_map<TTF_Font*, FontAtlas*> FontAtlas::atlases;
+
+// Next codepoint of a UTF-8 string, invalid bytes come out as '?'.
+static uint32_t DecodeUtf8(const std::string& text, size_t& i)
+{
+	uint8_t first = (uint8_t)text[i++];
+
+	if (first < 0x80)
+		return first;
+
+	int length = first >= 0xF0 ? 3 : first >= 0xE0 ? 2 : first >= 0xC0 ? 1 : 0;
+	if (length == 0)
+		return '?';
+
+	uint32_t codepoint = first & (0x3F >> length);
+
+	for (int k = 0; k < length; k++)
+	{
+		if (i >= text.size() || ((uint8_t)text[i] & 0xC0) != 0x80)
+			return '?';
+
+		codepoint = (codepoint << 6) | ((uint8_t)text[i++] & 0x3F);
+	}
+
+	return codepoint;
+}
+
+static std::string EncodeUtf8(uint32_t codepoint)
+{
+	std::string result;
+
+	if (codepoint < 0x80)
+	{
+		result += (char)codepoint;
+	}
+	else if (codepoint < 0x800)
+	{
+		result += (char)(0xC0 | (codepoint >> 6));
+		result += (char)(0x80 | (codepoint & 0x3F));
+	}
+	else
+	{
+		result += (char)(0xE0 | (codepoint >> 12));
+		result += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+		result += (char)(0x80 | (codepoint & 0x3F));
+	}
+
+	return result;
+}
+
+FontAtlas* FontAtlas::Get(TTF_Font* font)
+{
+	auto it = atlases.find(font);
+	if (it != atlases.end())
+		return it->second;
+
+	FontAtlas* atlas = new FontAtlas(font);
+	atlases[font] = atlas;
+
+	return atlas;
+}
+
+FontAtlas::FontAtlas(TTF_Font* font) : font(font)
+{
+	lineHeight = TTF_FontHeight(font);
+}
+
+FontAtlas::~FontAtlas()
+{
+	for (GLuint page : pages)
+	{
+		RenderState::OnTextureDeleted(page);
+		glDeleteTextures(1, &page);
+	}
+}
+
+void FontAtlas::AddPage()
+{
+	GLuint page;
+	glGenTextures(1, &page);
+	RenderState::BindTexture(GL_TEXTURE_2D, page);
+
+	// cleared so the padding around glyphs stays transparent under linear filtering
+	std::vector<uint8_t> empty(PageSize * PageSize * 4, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PageSize, PageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, empty.data());
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	pages.push_back(page);
+
+	cursorX = 0;
+	cursorY = 0;
+	shelfHeight = 0;
+}
+
+bool FontAtlas::Rasterize(uint32_t codepoint, Glyph& glyph)
+{
+	// the Uint16 glyph API of SDL_ttf only covers the basic plane
+	if (codepoint > 0xFFFF)
+		codepoint = '?';
+
+	int minX, maxX, minY, maxY, advance;
+	bool hasMetrics = TTF_GlyphMetrics(font, (Uint16)codepoint, &minX, &maxX, &minY, &maxY, &advance) == 0;
+
+	// rendered as a one character string, which puts the glyph on the baseline of a full line height cell
+	SDL_Color white = { 255, 255, 255, 255 };
+	SDL_Surface* surface = TTF_RenderUTF8_Blended(font, EncodeUtf8(codepoint).c_str(), white);
+
+	if (surface == nullptr)
+		return false;
+
+	int width = surface->w;
+	int height = surface->h;
+
+	glyph.advance = (float)(hasMetrics ? advance : width);
+	glyph.bearing = (float)(hasMetrics ? std::min(minX, 0) : 0);
+	glyph.size = glm::vec2((float)width, (float)height);
+
+	// white with the coverage in alpha, whatever the surface's pixel format
+	std::vector<uint8_t> pixels(width * height * 4);
+	uint8_t coverage = 0;
+
+	SDL_LockSurface(surface);
+
+	for (int row = 0; row < height; row++)
+	{
+		const uint8_t* source = (const uint8_t*)surface->pixels + row * surface->pitch;
+
+		for (int column = 0; column < width; column++)
+		{
+			Uint32 pixel = *(const Uint32*)(source + column * surface->format->BytesPerPixel);
+
+			Uint8 r, g, b, a;
+			SDL_GetRGBA(pixel, surface->format, &r, &g, &b, &a);
+
+			uint8_t* target = &pixels[(row * width + column) * 4];
+			target[0] = 255;
+			target[1] = 255;
+			target[2] = 255;
+			target[3] = a;
+
+			coverage = std::max(coverage, (uint8_t)a);
+		}
+	}
+
+	SDL_UnlockSurface(surface);
+	SDL_FreeSurface(surface);
+
+	// spaces only advance
+	if (coverage == 0)
+	{
+		glyph.size = glm::vec2(0.0f);
+		return true;
+	}
+
+	// one texel of padding on every side against bleeding between neighbours
+	int paddedWidth = width + 2;
+	int paddedHeight = height + 2;
+
+	if (paddedWidth > PageSize || paddedHeight > PageSize)
+		return false;
+
+	if (pages.empty())
+		AddPage();
+
+	if (cursorX + paddedWidth > PageSize)
+	{
+		cursorX = 0;
+		cursorY += shelfHeight;
+		shelfHeight = 0;
+	}
+
+	if (cursorY + paddedHeight > PageSize)
+		AddPage();
+
+	int x = cursorX + 1;
+	int y = cursorY + 1;
+
+	cursorX += paddedWidth;
+	shelfHeight = std::max(shelfHeight, paddedHeight);
+
+	glyph.texture = pages.back();
+
+	RenderState::BindTexture(GL_TEXTURE_2D, glyph.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	glyph.uvMin = glm::vec2((float)x, (float)y) / (float)PageSize;
+	glyph.uvMax = glm::vec2((float)(x + width), (float)(y + height)) / (float)PageSize;
+
+	return true;
+}
+
+const FontAtlas::Glyph& FontAtlas::GetGlyph(uint32_t codepoint)
+{
+	auto it = glyphs.find(codepoint);
+	if (it != glyphs.end())
+		return it->second;
+
+	Glyph& glyph = glyphs[codepoint];
+	glyph.valid = Rasterize(codepoint, glyph);
+
+	return glyph;
+}
+
+const TextLayout& FontAtlas::GetLayout(const std::string& text)
+{
+	auto it = layouts.find(text);
+	if (it != layouts.end())
+		return it->second;
+
+	// text that keeps changing would grow the cache forever
+	if (layouts.size() >= MaxCachedLayouts)
+		layouts.clear();
+
+	TextLayout& layout = layouts[text];
+
+	float pen = 0.0f;
+	float right = 0.0f;
+
+	size_t i = 0;
+	while (i < text.size())
+	{
+		uint32_t codepoint = DecodeUtf8(text, i);
+
+		const Glyph& glyph = GetGlyph(codepoint);
+		if (glyph.valid == false)
+			continue;
+
+		if (glyph.size.x > 0 && glyph.size.y > 0)
+		{
+			float x = pen + glyph.bearing;
+
+			layout.glyphs.push_back({ glm::vec2(x, 0.0f), glyph.size, glyph.uvMin, glyph.uvMax, glyph.texture });
+			right = std::max(right, x + glyph.size.x);
+		}
+
+		pen += glyph.advance;
+	}
+
+	layout.size = glm::vec2(std::max(pen, right), (float)lineHeight);
+
+	return layout;
+}
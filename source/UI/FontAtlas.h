@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../glm.h"
+#include "../gl.h"
+#include <SDL2/SDL_ttf.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Glyph quad of a laid out string, positions relative to the string's top left corner.
+struct TextGlyph {
+    glm::vec2 position;
+    glm::vec2 size;
+    glm::vec2 uvMin;
+    glm::vec2 uvMax;
+    GLuint texture;
+};
+
+struct TextLayout {
+    std::vector<TextGlyph> glyphs;
+    glm::vec2 size = glm::vec2(0.0f);
+};
+
+// Glyphs of one TTF_Font (so one font file and size), rasterized on first use with SDL_ttf
+// and packed into shelves of PageSize x PageSize textures; a new page is opened when one is full.
+// Laid out strings are cached, so a string that doesn't change costs one lookup per frame.
+//
+// Glyphs are white with coverage in alpha, the draw color tints them. Use from the render
+// thread only, rasterizing uploads to GL.
+class FontAtlas {
+public:
+    static const int PageSize = 1024;
+
+    // layouts kept before the cache is dropped, for text that changes every frame
+    static const size_t MaxCachedLayouts = 1024;
+
+    static FontAtlas* Get(TTF_Font* font);
+
+    const TextLayout& GetLayout(const std::string& text);
+
+    int GetLineHeight() const { return lineHeight; }
+
+    ~FontAtlas();
+
+private:
+    struct Glyph {
+        bool valid = false;
+        GLuint texture = 0;
+        glm::vec2 size = glm::vec2(0.0f);
+        glm::vec2 uvMin = glm::vec2(0.0f);
+        glm::vec2 uvMax = glm::vec2(0.0f);
+        float advance = 0.0f;
+        // negative left bearing, the ink SDL_ttf moved to x = 0 of the glyph's surface
+        float bearing = 0.0f;
+    };
+
+    TTF_Font* font = nullptr;
+    int lineHeight = 0;
+
+    std::vector<GLuint> pages;
+
+    // shelf packing cursor in the last page
+    int cursorX = 0;
+    int cursorY = 0;
+    int shelfHeight = 0;
+
+    std::unordered_map<uint32_t, Glyph> glyphs;
+    std::unordered_map<std::string, TextLayout> layouts;
+
+    static std::unordered_map<TTF_Font*, FontAtlas*> atlases;
+
+    explicit FontAtlas(TTF_Font* font);
+
+    const Glyph& GetGlyph(uint32_t codepoint);
+    bool Rasterize(uint32_t codepoint, Glyph& glyph);
+    void AddPage();
+};
@@ -59,14 +59,12 @@ public:
 		return false;
 	}
 
-	void Draw()
+	void DrawSelf()
 	{
 
 		vec2 pos = position + offset;
 
 		UiRenderer::DrawTexturedRect(pos, size, tex->getID());
-
-		UiElement::Draw();
 	}
 
 };
\ No newline at end of file
@@ -31,6 +31,13 @@ public:
         return bottomRight - topLeft;
     }
 
+protected:
+
+    bool LayoutDependsOnChildren() override
+    {
+        return true;
+    }
+
 
 
 private:
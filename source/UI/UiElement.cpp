@@ -4,21 +4,37 @@
 #include "../Camera.h"
 #include "../Input.h"
 #include "UiRenderer.h" // Assume you have a DrawRect or DrawTexturedRect method
+#include <cassert>
+#include <thread>
 
 bool UiElement::drawAllBorders = false;
 UiElement* UiElement::Viewport = nullptr;
 
+// static initialization runs on the main thread, which renders
+static const std::thread::id uiThread = std::this_thread::get_id();
+
+void UiElement::CheckThread() {
+    assert(std::this_thread::get_id() == uiThread && "the UI tree is only used from the render thread");
+}
+
 void UiElement::AddChild(std::shared_ptr<UiElement> child) {
+    CheckThread();
     child->parent = this;
+    child->MarkLayoutDirty();
     children.push_back(child);
+    MarkLayoutDirty();
 }
 
 void UiElement::RemoveChild(std::shared_ptr<UiElement> child) {
+    CheckThread();
     children.erase(std::remove(children.begin(), children.end(), child), children.end());
+    MarkLayoutDirty();
 }
 
 void UiElement::ClearChildren() {
+    CheckThread();
     children.clear();
+    MarkLayoutDirty();
 }
 
 void UiElement::UpdateOffsets() {
@@ -33,39 +49,108 @@ void UiElement::UpdateOffsets() {
     bottomRight = topLeft + sz;
 }
 
-void UiElement::UpdateChildrenOffsets() {
+bool UiElement::HasLayoutChanged() {
+    return size != layoutSize || position != layoutPosition ||
+        origin != layoutOrigin || pivot != layoutPivot ||
+        parentTopLeft != layoutParentTopLeft || parentBottomRight != layoutParentBottomRight;
+}
+
+void UiElement::SaveLayoutInputs() {
+    layoutSize = size;
+    layoutPosition = position;
+    layoutOrigin = origin;
+    layoutPivot = pivot;
+    layoutParentTopLeft = parentTopLeft;
+    layoutParentBottomRight = parentBottomRight;
+}
+
+bool UiElement::LayoutIfNeeded() {
+    glm::vec2 oldTopLeft = topLeft;
+    glm::vec2 oldBottomRight = bottomRight;
+
+    if (layoutDirty || HasLayoutChanged()) {
+        UpdateLayout();
+    }
+    else if (UpdateChildrenLayout() && LayoutDependsOnChildren()) {
+        // a descendant changed size, which moves this element's content
+        UpdateLayout();
+    }
+
+    SaveLayoutInputs();
+    layoutDirty = false;
+
+    return topLeft != oldTopLeft || bottomRight != oldBottomRight;
+}
+
+void UiElement::UpdateLayout() {
+    UpdateOffsets();
+
+    bool childrenChanged = UpdateChildrenLayout();
+
+    // children are measured first, then placed by their sizes
+    if (ArrangeChildren())
+        childrenChanged = UpdateChildrenLayout() || childrenChanged;
+
+    if (childrenChanged && LayoutDependsOnChildren()) {
+        glm::vec2 oldTopLeft = topLeft;
+        UpdateOffsets();
+
+        // the new size moved this element through its pivot, which moves the children too
+        if (topLeft != oldTopLeft)
+            UpdateChildrenLayout();
+    }
+}
+
+bool UiElement::UpdateChildrenLayout() {
+    bool changed = false;
+
     for (auto& child : children) {
         child->parentTopLeft = topLeft;
         child->parentBottomRight = bottomRight;
         child->parent = this;
-        child->UpdateOffsets();
+
+        if (child->LayoutIfNeeded())
+            changed = true;
     }
+
+    return changed;
 }
 
 void UiElement::UpdateChildren() {
     for (auto& child : children) {
-        child->parentTopLeft = topLeft;
-        child->parentBottomRight = bottomRight;
         child->parent = this;
         child->Update();
     }
 }
 
 void UiElement::FinalizeChildren() {
-    finalizedChildren = children;
-    for (auto& child : finalizedChildren)
-        child->FinalizeChildren();
+    CheckThread();
+
+    drawList.clear();
+    AddToDrawList(drawList);
+}
+
+void UiElement::AddToDrawList(std::vector<DrawCommand>& list) {
+    list.push_back({ this, DrawOp::Self });
+
+    if (clipChildren)
+        list.push_back({ this, DrawOp::PushClip });
+
+    for (auto& child : children)
+        if (child->visible)
+            child->AddToDrawList(list);
+
+    if (clipChildren)
+        list.push_back({ this, DrawOp::PopClip });
+
+    if (drawBorder || drawAllBorders)
+        list.push_back({ this, DrawOp::Border });
 }
 
 void UiElement::Update() 
 {
-    for (int i = 0; i < 5; ++i) {
-        UpdateChildrenOffsets();
-        UpdateOffsets();
-    }
+    CheckThread();
 
-    UpdateChildrenOffsets();
-    
     UpdateChildren();
 
     if (Input::LockCursor)
@@ -77,11 +162,10 @@ void UiElement::Update()
     float screenToViewportRatio = Camera::ScreenHeight / 1080.0F;
 
     glm::vec2 mousePos = Input::MousePos / screenToViewportRatio; // assume scaled to screen
-    glm::vec2 p = position + offset;
-    glm::vec2 sz = GetSize();
 
-    hovering = (mousePos.x >= p.x && mousePos.x <= p.x + sz.x &&
-        mousePos.y >= p.y && mousePos.y <= p.y + sz.y);
+    // rect of the last layout
+    hovering = (mousePos.x >= topLeft.x && mousePos.x <= bottomRight.x &&
+        mousePos.y >= topLeft.y && mousePos.y <= bottomRight.y);
 
 
 }
@@ -95,14 +179,25 @@ glm::vec2 UiElement::GetSize() {
 }
 
 void UiElement::Draw() {
-    for (auto& child : finalizedChildren)
-        if (child->visible)
-            child->Draw();
-
-    if (drawBorder || drawAllBorders) {
-        glm::vec2 pos = position + offset;
-        glm::vec2 sz = GetSize();
-        UiRenderer::DrawBorderRect(pos, sz, glm::vec4(1.0f, 0.0f, 0.0f, 0.3f)); // Red with alpha
+    CheckThread();
+
+    for (const DrawCommand& command : drawList) {
+        UiElement* element = command.element;
+
+        switch (command.op) {
+        case DrawOp::Self:
+            element->DrawSelf();
+            break;
+        case DrawOp::PushClip:
+            UiRenderer::PushClipRect(element->topLeft, element->bottomRight - element->topLeft);
+            break;
+        case DrawOp::PopClip:
+            UiRenderer::PopClipRect();
+            break;
+        case DrawOp::Border:
+            UiRenderer::DrawBorderRect(element->topLeft, element->bottomRight - element->topLeft, glm::vec4(1.0f, 0.0f, 0.0f, 0.3f)); // Red with alpha
+            break;
+        }
     }
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../glm.h"
+#include <cstdint>
 #include <vector>
 #include <memory>
 
@@ -27,6 +28,13 @@ namespace Origins {
     }
 }
 
+// Layout is incremental: LayoutIfNeeded only places elements that were marked dirty or whose
+// size, position, origin, pivot or parent rect changed, so an unchanged tree costs one
+// comparison per element. Drawing walks a flat list built once per frame by FinalizeChildren.
+//
+// The tree belongs to the render (main) thread: it is built, updated and drawn there while the
+// simulation thread runs. Game code on the simulation thread must not touch it; debug builds
+// assert this when the tree is changed, updated or drawn.
 class UiElement {
 public:
     static UiElement* Viewport;
@@ -39,20 +47,21 @@ public:
     glm::vec2 pivot = glm::vec2(0.0f);
     glm::vec2 offset = glm::vec2(0.0f);
 
-    glm::vec2 topLeft;
-    glm::vec2 bottomRight;
+    glm::vec2 topLeft = glm::vec2(0.0f);
+    glm::vec2 bottomRight = glm::vec2(0.0f);
 
-    glm::vec2 parentTopLeft;
-    glm::vec2 parentBottomRight;
+    glm::vec2 parentTopLeft = glm::vec2(0.0f);
+    glm::vec2 parentBottomRight = glm::vec2(0.0f);
 
     bool visible = true;
     bool drawBorder = false;
+    // clips the children's drawing to this element's rect
+    bool clipChildren = false;
     static bool drawAllBorders;
     bool hovering = false;
 
     UiElement* parent = nullptr;
     std::vector<std::shared_ptr<UiElement>> children;
-    std::vector<std::shared_ptr<UiElement>> finalizedChildren;
 
     UiElement() = default;
 
@@ -65,14 +74,74 @@ public:
     virtual void Update();
     virtual void UpdateChildren();
     virtual void UpdateOffsets();
-    virtual void UpdateChildrenOffsets();
+
+    // Lays out this element if it is dirty or its layout inputs changed since the last layout,
+    // otherwise only visits the children. Returns true if the element's rect moved or resized.
+    bool LayoutIfNeeded();
+
+    // Forces a relayout on the next LayoutIfNeeded, for changes the input comparison can't see.
+    void MarkLayoutDirty() { layoutDirty = true; }
+
+    // Builds the flat draw list of the visible tree, call on the root before Draw.
     virtual void FinalizeChildren();
 
     virtual glm::vec2 GetOrigin();
     virtual glm::vec2 GetSize();
 
+    // Draws the list built by FinalizeChildren.
     virtual void Draw();
 
+    // Draws only this element, children come after it in the draw list.
+    virtual void DrawSelf() {}
+
     static glm::vec2 WorldToScreenSpace(const glm::vec3& pos);
     static glm::vec2 WorldToScreenSpace(const glm::vec3& pos, bool& inScreen);
+
+protected:
+
+    // Places this element and lays out the children whose inputs changed.
+    virtual void UpdateLayout();
+    bool UpdateChildrenLayout();
+
+    // Sets the children's positions from their measured sizes, true if any moved.
+    virtual bool ArrangeChildren() { return false; }
+
+    // Elements sized or arranged by their children relayout when a child's rect changes.
+    virtual bool LayoutDependsOnChildren() { return false; }
+
+    // Compares the layout inputs with the ones of the last layout.
+    virtual bool HasLayoutChanged();
+    virtual void SaveLayoutInputs();
+
+private:
+
+    enum class DrawOp : uint8_t {
+        Self,
+        PushClip,
+        PopClip,
+        Border
+    };
+
+    struct DrawCommand {
+        UiElement* element;
+        DrawOp op;
+    };
+
+    bool layoutDirty = true;
+
+    // inputs of the last layout
+    glm::vec2 layoutSize = glm::vec2(0.0f);
+    glm::vec2 layoutPosition = glm::vec2(0.0f);
+    glm::vec2 layoutOrigin = glm::vec2(0.0f);
+    glm::vec2 layoutPivot = glm::vec2(0.0f);
+    glm::vec2 layoutParentTopLeft = glm::vec2(0.0f);
+    glm::vec2 layoutParentBottomRight = glm::vec2(0.0f);
+
+    // raw pointers into the tree, valid because only the render thread changes it and it calls
+    // FinalizeChildren right before Draw
+    std::vector<DrawCommand> drawList;
+
+    void AddToDrawList(std::vector<DrawCommand>& list);
+
+    static void CheckThread();
 };
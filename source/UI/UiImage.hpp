@@ -22,14 +22,12 @@ public:
 
 	}
 
-	void Draw()
+	void DrawSelf()
 	{
 
 		vec2 pos = position + offset;
 
 		UiRenderer::DrawTexturedRect(pos, size, tex->getID());
-
-		UiElement::Draw();
 	}
 
 private:
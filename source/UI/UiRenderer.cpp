@@ -2,171 +2,322 @@
 
 #include "../gl.h"
 #include "../ShaderManager.h"
+#include "../RenderState.h"
 
 #include "../Camera.h"
 
-static GLuint quadVAO = 0;
-static GLuint quadVBO = 0;
-static ShaderProgram* texturedShader = nullptr;
-static ShaderProgram* flatColorShader = nullptr;
+#include "FontAtlas.h"
 
-void UiRenderer::Init() {
-	float quadVertices[] = {
-		// pos      // uv
-		 0.0f, 1.0f,  0.0f, 1.0f,
-		 1.0f, 0.0f,  1.0f, 0.0f,
-		 0.0f, 0.0f,  0.0f, 0.0f,
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
 
-		 0.0f, 1.0f,  0.0f, 1.0f,
-		 1.0f, 1.0f,  1.0f, 1.0f,
-		 1.0f, 0.0f,  1.0f, 0.0f,
-	};
+struct UiVertex {
+	glm::vec2 position;
+	glm::vec2 uv;
+	uint32_t color;
+};
 
-	glGenVertexArrays(1, &quadVAO);
-	glGenBuffers(1, &quadVBO);
+// Quads with one texture and clip rect, drawn with one call. bounds covers all of them for the overlap test.
+struct UiBatch {
+	GLuint texture = 0;
+	int clip = -1;
+	glm::vec2 boundsMin;
+	glm::vec2 boundsMax;
+	std::vector<UiVertex> vertices;
+};
 
-	glBindVertexArray(quadVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+// how many batches back a quad may move to join one with its texture
+static const int BatchLookBack = 8;
 
-	glEnableVertexAttribArray(0); // position
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+// reference height of the UI coordinate space, the width follows the aspect ratio
+static const float UiHeight = 1080.0f;
 
-	glEnableVertexAttribArray(1); // texcoord
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+static GLuint batchVAO = 0;
+static GLuint batchVBO = 0;
+static GLuint whiteTexture = 0;
+static ShaderProgram* batchShader = nullptr;
+
+// batches keep their vertex capacity between frames, only the first batchCount are in use
+static std::vector<UiBatch> batches;
+static size_t batchCount = 0;
+
+static std::vector<UiVertex> uploadVertices;
+
+// clip rects in UI units, batches refer to them by index; the stack holds the active ones
+static std::vector<glm::vec4> clipRects;
+static std::vector<int> clipStack;
 
-	glBindVertexArray(0);
+static UiRenderer::Stats currentStats;
+static UiRenderer::Stats lastStats;
 
-	texturedShader = ShaderManager::GetShaderProgram("ui", "ui_textured");
-	flatColorShader = ShaderManager::GetShaderProgram("ui", "ui_flatcolor");
+static uint32_t PackColor(const glm::vec4& color)
+{
+	glm::vec4 clamped = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
 
+	return (uint32_t)clamped.r | ((uint32_t)clamped.g << 8) | ((uint32_t)clamped.b << 16) | ((uint32_t)clamped.a << 24);
 }
 
-void UiRenderer::Shutdown() {
-	glDeleteVertexArrays(1, &quadVAO);
-	glDeleteBuffers(1, &quadVBO);
-	delete texturedShader;
-	delete flatColorShader;
+static bool Overlaps(const glm::vec2& minA, const glm::vec2& maxA, const glm::vec2& minB, const glm::vec2& maxB)
+{
+	return minA.x < maxB.x && minB.x < maxA.x && minA.y < maxB.y && minB.y < maxA.y;
 }
 
-void SetShaderProjection(ShaderProgram* shader)
+static void AddQuad(const glm::vec2& min, const glm::vec2& max, const glm::vec2& uvMin, const glm::vec2& uvMax, GLuint texture, const glm::vec4& color)
 {
+	int clip = clipStack.empty() ? -1 : clipStack.back();
+
+	if (clip >= 0)
+	{
+		const glm::vec4& rect = clipRects[clip];
+
+		if (Overlaps(min, max, glm::vec2(rect.x, rect.y), glm::vec2(rect.z, rect.w)) == false)
+			return;
+	}
+
+	// walk back over batches the quad doesn't overlap, looking for one it can join
+	UiBatch* target = nullptr;
+
+	size_t lookBackEnd = batchCount > BatchLookBack ? batchCount - BatchLookBack : 0;
+
+	for (size_t i = batchCount; i > lookBackEnd; i--)
+	{
+		UiBatch& batch = batches[i - 1];
 
-	int screenWidth = 1080 * Camera::AspectRatio;
-	int screenHeight = 1080;
-
-	glm::mat4 uiProjection = glm::ortho(
-		0.0f,
-		static_cast<float>(screenWidth),
-		static_cast<float>(screenHeight),
-		0.0f,
-		-1.0f,
-		1.0f
-	);
-	shader->SetUniform("u_Projection", uiProjection);
+		if (batch.texture == texture && batch.clip == clip)
+		{
+			target = &batch;
+			break;
+		}
+
+		if (Overlaps(min, max, batch.boundsMin, batch.boundsMax))
+			break;
+	}
+
+	if (target == nullptr)
+	{
+		if (batchCount == batches.size())
+			batches.emplace_back();
+
+		target = &batches[batchCount++];
+		target->texture = texture;
+		target->clip = clip;
+		target->boundsMin = min;
+		target->boundsMax = max;
+		target->vertices.clear();
+	}
+
+	target->boundsMin = glm::min(target->boundsMin, min);
+	target->boundsMax = glm::max(target->boundsMax, max);
+
+	uint32_t packed = PackColor(color);
+
+	UiVertex topLeft = { min, uvMin, packed };
+	UiVertex topRight = { glm::vec2(max.x, min.y), glm::vec2(uvMax.x, uvMin.y), packed };
+	UiVertex bottomLeft = { glm::vec2(min.x, max.y), glm::vec2(uvMin.x, uvMax.y), packed };
+	UiVertex bottomRight = { max, uvMax, packed };
+
+	UiVertex quad[] = { bottomLeft, topRight, topLeft, bottomLeft, bottomRight, topRight };
+	target->vertices.insert(target->vertices.end(), quad, quad + 6);
+
+	currentStats.Quads++;
 }
 
-void UiRenderer::DrawTexturedRect(const glm::vec2& pos, const glm::vec2& size, GLuint texture, const glm::vec4& color) {
-	texturedShader->UseProgram();
+void UiRenderer::Init() {
+	glGenVertexArrays(1, &batchVAO);
+	glGenBuffers(1, &batchVBO);
+
+	RenderState::BindVertexArray(batchVAO);
+	RenderState::BindBuffer(GL_ARRAY_BUFFER, batchVBO);
+
+	glEnableVertexAttribArray(0); // position
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(UiVertex), (void*)offsetof(UiVertex, position));
+
+	glEnableVertexAttribArray(1); // texcoord
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(UiVertex), (void*)offsetof(UiVertex, uv));
 
-	SetShaderProjection(texturedShader);
+	glEnableVertexAttribArray(2); // color
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(UiVertex), (void*)offsetof(UiVertex, color));
 
-	glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(pos, 0.0f));
-	model = glm::scale(model, glm::vec3(size, 1.0f));
-	texturedShader->SetUniform("u_Model", model);
-	texturedShader->SetUniform("u_Color", color);
+	RenderState::BindVertexArray(0);
 
-	texturedShader->SetTexture("u_Texture", texture);
+	// flat colored rects sample this so they batch with everything else
+	uint32_t white = 0xFFFFFFFF;
 
-	glBindVertexArray(quadVAO);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glGenTextures(1, &whiteTexture);
+	RenderState::BindTexture(GL_TEXTURE_2D, whiteTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	batchShader = ShaderManager::GetShaderProgram("ui_batched", "ui_batched");
+
+}
+
+void UiRenderer::Shutdown() {
+	RenderState::OnVertexArrayDeleted(batchVAO);
+	RenderState::OnBufferDeleted(batchVBO);
+	RenderState::OnTextureDeleted(whiteTexture);
+	glDeleteVertexArrays(1, &batchVAO);
+	glDeleteBuffers(1, &batchVBO);
+	glDeleteTextures(1, &whiteTexture);
 }
 
-void UiRenderer::DrawBorderRect(const glm::vec2& pos, const glm::vec2& size, const glm::vec4& color) 
+void UiRenderer::Begin()
 {
-#ifndef __EMSCRIPTEN__
+	batchCount = 0;
 
+	clipRects.clear();
+	clipStack.clear();
 
+	currentStats = Stats();
+}
 
-	flatColorShader->UseProgram();
-	SetShaderProjection(flatColorShader);
-	glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(pos, 0.0f));
-	model = glm::scale(model, glm::vec3(size, 1.0f));
-	flatColorShader->SetUniform("u_Model", model);
-	flatColorShader->SetUniform("u_Color", color);
+void UiRenderer::End()
+{
+	if (batchCount == 0)
+	{
+		lastStats = currentStats;
+		return;
+	}
 
-	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-	glBindVertexArray(quadVAO);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	uploadVertices.clear();
+	for (size_t i = 0; i < batchCount; i++)
+		uploadVertices.insert(uploadVertices.end(), batches[i].vertices.begin(), batches[i].vertices.end());
 
-#endif // !__EMSCRIPTEN
-}
+	float screenWidth = UiHeight * Camera::AspectRatio;
 
-namespace UiRenderer {
+	glm::mat4 uiProjection = glm::ortho(0.0f, screenWidth, UiHeight, 0.0f, -1.0f, 1.0f);
 
-	void DrawText(const std::string& text, TTF_Font* font, const glm::vec2& pos, const glm::vec4& color, const glm::vec2& scale)
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	batchShader->UseProgram();
+	batchShader->SetUniform("u_Projection", uiProjection);
+
+	RenderState::BindVertexArray(batchVAO);
+	RenderState::BindBuffer(GL_ARRAY_BUFFER, batchVBO);
+
+	glBufferData(GL_ARRAY_BUFFER, uploadVertices.size() * sizeof(UiVertex), uploadVertices.data(), GL_STREAM_DRAW);
+
+	// UI units to framebuffer pixels, GL scissor counts rows from the bottom
+	float pixelScale = Camera::ScreenHeight / UiHeight;
+
+	int activeClip = -1;
+	GLint first = 0;
+
+	for (size_t i = 0; i < batchCount; i++)
 	{
-		if (!font) {
-			std::cerr << "No font provided for DrawText." << std::endl;
-			return;
+		const UiBatch& batch = batches[i];
+
+		if (batch.clip != activeClip)
+		{
+			if (batch.clip < 0)
+			{
+				glDisable(GL_SCISSOR_TEST);
+			}
+			else
+			{
+				const glm::vec4& rect = clipRects[batch.clip];
+
+				if (activeClip < 0)
+					glEnable(GL_SCISSOR_TEST);
+
+				GLint x = (GLint)floor(rect.x * pixelScale);
+				GLint y = (GLint)floor((UiHeight - rect.w) * pixelScale);
+				GLint right = (GLint)ceil(rect.z * pixelScale);
+				GLint top = (GLint)ceil((UiHeight - rect.y) * pixelScale);
+
+				glScissor(x, y, std::max(right - x, 0), std::max(top - y, 0));
+			}
+
+			activeClip = batch.clip;
 		}
 
-		// Convert our glm color (0.0 - 1.0) to SDL_Color (0 - 255)
-		SDL_Color sdlColor = {
-			static_cast<Uint8>(color.r * 255),
-			static_cast<Uint8>(color.g * 255),
-			static_cast<Uint8>(color.b * 255),
-			static_cast<Uint8>(color.a * 255)
-		};
-
-		// Render the text to an SDL_Surface using blended rendering
-		SDL_Surface* surface = TTF_RenderUTF8_Blended(font, text.c_str(), sdlColor);
-		if (!surface) {
-			std::cerr << "TTF_RenderUTF8_Blended Error: " << TTF_GetError() << std::endl;
-			return;
-		}
+		batchShader->SetTexture("u_Texture", batch.texture);
 
-		GLuint textureID;
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		glDrawArrays(GL_TRIANGLES, first, (GLsizei)batch.vertices.size());
+		first += (GLint)batch.vertices.size();
 
-		// Ensure proper pixel alignment and row length.
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		glPixelStorei(GL_UNPACK_ROW_LENGTH, surface->pitch / surface->format->BytesPerPixel);
+		currentStats.DrawCalls++;
+	}
 
-		// Set texture parameters for scaling and wrapping.
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	if (activeClip >= 0)
+		glDisable(GL_SCISSOR_TEST);
 
-		// Determine the format: use GL_RGB or GL_RGBA based on the surface.
-		GLenum format = (surface->format->BytesPerPixel == 3) ? GL_RGB : GL_RGBA;
-		glTexImage2D(GL_TEXTURE_2D, 0, format,
-			surface->w, surface->h, 0, format,
-			GL_UNSIGNED_BYTE, surface->pixels);
+	lastStats = currentStats;
 
-		// Reset UNPACK_ROW_LENGTH to default.
-		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	batchCount = 0;
+}
 
-		// Enable blending so that the alpha channel is used.
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+const UiRenderer::Stats& UiRenderer::GetStats()
+{
+	return lastStats;
+}
 
-		// Compute the drawing size applying the provided scale.
-		glm::vec2 drawSize(scale.x * surface->w, scale.y * surface->h);
+void UiRenderer::PushClipRect(const glm::vec2& pos, const glm::vec2& size)
+{
+	glm::vec4 rect = glm::vec4(pos, pos + size);
 
-		// Draw the text as a textured quad.
-		DrawTexturedRect(pos, drawSize, textureID);
+	if (clipStack.empty() == false)
+	{
+		const glm::vec4& parent = clipRects[clipStack.back()];
 
-		// Cleanup texture and surface.
-		glDeleteTextures(1, &textureID);
-		SDL_FreeSurface(surface);
+		rect = glm::vec4(glm::max(glm::vec2(rect), glm::vec2(parent)), glm::min(glm::vec2(rect.z, rect.w), glm::vec2(parent.z, parent.w)));
 	}
 
-} // namespace UiRenderer
+	clipStack.push_back((int)clipRects.size());
+	clipRects.push_back(rect);
+}
+
+void UiRenderer::PopClipRect()
+{
+	if (clipStack.empty() == false)
+		clipStack.pop_back();
+}
 
+void UiRenderer::DrawTexturedRect(const glm::vec2& pos, const glm::vec2& size, GLuint texture, const glm::vec4& color) {
+	AddQuad(pos, pos + size, glm::vec2(0.0f), glm::vec2(1.0f), texture, color);
+}
+
+void UiRenderer::DrawTexturedRect(const glm::vec2& pos, const glm::vec2& size, GLuint texture, const glm::vec2& uvMin, const glm::vec2& uvMax, const glm::vec4& color) {
+	AddQuad(pos, pos + size, uvMin, uvMax, texture, color);
+}
+
+void UiRenderer::DrawRect(const glm::vec2& pos, const glm::vec2& size, const glm::vec4& color) {
+	AddQuad(pos, pos + size, glm::vec2(0.0f), glm::vec2(1.0f), whiteTexture, color);
+}
 
+void UiRenderer::DrawBorderRect(const glm::vec2& pos, const glm::vec2& size, const glm::vec4& color)
+{
+	// four one unit wide edges, batched like any other rect
+	const float width = 1.0f;
+
+	DrawRect(pos, glm::vec2(size.x, width), color);
+	DrawRect(glm::vec2(pos.x, pos.y + size.y - width), glm::vec2(size.x, width), color);
+	DrawRect(glm::vec2(pos.x, pos.y + width), glm::vec2(width, size.y - width * 2), color);
+	DrawRect(glm::vec2(pos.x + size.x - width, pos.y + width), glm::vec2(width, size.y - width * 2), color);
+}
 
+namespace UiRenderer {
 
+	void DrawText(const std::string& text, TTF_Font* font, const glm::vec2& pos, const glm::vec4& color, const glm::vec2& scale)
+	{
+		if (!font) {
+			std::cerr << "No font provided for DrawText." << std::endl;
+			return;
+		}
+
+		const TextLayout& layout = FontAtlas::Get(font)->GetLayout(text);
+
+		for (const TextGlyph& glyph : layout.glyphs)
+		{
+			glm::vec2 min = pos + glyph.position * scale;
+			glm::vec2 max = min + glyph.size * scale;
+
+			AddQuad(min, max, glyph.uvMin, glyph.uvMax, glyph.texture, color);
+		}
+	}
+
+} // namespace UiRenderer
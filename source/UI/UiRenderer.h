@@ -5,18 +5,41 @@
 
 #include "../gl.h"
 
+#include <cstdint>
 #include <string>
 
 using namespace std;
 
 class Texture;
 
+// 2D batcher for the UI. Draw calls between Begin and End only collect quads; End uploads
+// them into one streaming vertex buffer and draws them in as few calls as the textures and
+// clip rects allow. A quad joins an earlier batch with the same texture and clip rect when
+// nothing drawn in between overlaps it, so the painter's order is kept.
 namespace UiRenderer {
+    struct Stats {
+        uint32_t Quads = 0;
+        uint32_t DrawCalls = 0;
+    };
+
     void Init(); // Call once at startup
     void Shutdown(); // Optional
+
+    void Begin();
+    void End();
+
+    // counts of the last End
+    const Stats& GetStats();
+
+    // Clips everything drawn until the matching PopClipRect to the rect, intersected with the current one.
+    void PushClipRect(const glm::vec2& pos, const glm::vec2& size);
+    void PopClipRect();
+
     void DrawTexturedRect(const glm::vec2& pos, const glm::vec2& size, GLuint texture, const glm::vec4& color = glm::vec4(1.0f));
+    void DrawTexturedRect(const glm::vec2& pos, const glm::vec2& size, GLuint texture, const glm::vec2& uvMin, const glm::vec2& uvMax, const glm::vec4& color);
+    void DrawRect(const glm::vec2& pos, const glm::vec2& size, const glm::vec4& color);
     void DrawBorderRect(const glm::vec2& pos, const glm::vec2& size, const glm::vec4& color);
-    // Draw text using SDL_TTF. This creates an SDL surface and a temporary OpenGL texture,
-    // then draws it as a textured quad.
+    // Draws text from the font's FontAtlas, one quad per glyph. Layouts are cached per string,
+    // so unchanged text only rasterizes on first use.
     void DrawText(const std::string& text, TTF_Font* font, const glm::vec2& pos, const glm::vec4& color, const glm::vec2& scale);
 }
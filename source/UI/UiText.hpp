@@ -2,6 +2,7 @@
 
 #include "UiElement.h"   // Assumed to be provided in your project
 #include "UiRenderer.h"    // Assumed to be provided in your project
+#include "FontAtlas.h"
 #include <SDL2/SDL_ttf.h>
 #include <string>
 #include "../glm.h"
@@ -21,26 +22,24 @@ public:
 
     virtual ~UiText() = default;
 
-    // Update recalculates the size and updates base UiElement properties.
-    virtual void Update() override {
-        size = GetSize();
-        UiElement::Update();
-    }
-
-    // GetSize measures the text using SDL_TTF and scales the result.
+    // GetSize measures the text from its cached atlas layout and scales the result.
+    // The measurement is kept until the text, font or size changes.
     virtual glm::vec2 GetSize() override {
         if (!font) return glm::vec2(0.0f);
-        int w = 0, h = 0;
-        if (TTF_SizeUTF8(font, text.c_str(), &w, &h) != 0) {
-            // If there's an error, return zero size.
-            return glm::vec2(0.0f);
+
+        if (text != measuredText || font != measuredFont || fontSize != measuredFontSize) {
+            // Scale based on fontSize relative to a 72 DPI reference.
+            measuredSize = FontAtlas::Get(font)->GetLayout(text).size * (fontSize / 72.f);
+            measuredText = text;
+            measuredFont = font;
+            measuredFontSize = fontSize;
         }
-        // Scale based on fontSize relative to a 72 DPI reference.
-        return glm::vec2(w, h) * (fontSize / 72.f);
+
+        return measuredSize;
     }
 
     // Draw renders the text using the Renderer::DrawText method.
-    virtual void Draw() override {
+    virtual void DrawSelf() override {
         // Calculate the drawing position by adding the element offset.
         glm::vec2 pos = position + offset;
 
@@ -49,8 +48,29 @@ public:
 
         // Draw the text.
         UiRenderer::DrawText(text, font, pos, baseColor, scale);
+    }
+
+protected:
 
-        // Optionally, draw child elements and borders.
-        UiElement::Draw();
+    virtual bool HasLayoutChanged() override {
+        return UiElement::HasLayoutChanged() || text != layoutText || font != layoutFont || fontSize != layoutFontSize;
     }
+
+    virtual void SaveLayoutInputs() override {
+        UiElement::SaveLayoutInputs();
+        layoutText = text;
+        layoutFont = font;
+        layoutFontSize = fontSize;
+    }
+
+private:
+
+    std::string measuredText;
+    TTF_Font* measuredFont = nullptr;
+    float measuredFontSize = 0.0f;
+    glm::vec2 measuredSize = glm::vec2(0.0f);
+
+    std::string layoutText;
+    TTF_Font* layoutFont = nullptr;
+    float layoutFontSize = 0.0f;
 };
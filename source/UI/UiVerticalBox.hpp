@@ -7,22 +7,31 @@ class UiVerticalBox : public UiContentBox
 {
 public:
 	
+	// MarkLayoutDirty after changing it
 	float ContentDistance = 5;
 
-	void Update()
+protected:
+
+	// placed one after another by the sizes measured in the last layout pass
+	bool ArrangeChildren() override
 	{
-		int i = -1;
+		bool moved = false;
+		float start = 0;
 
-		for (auto elem : children)
+		for (auto& elem : children)
 		{
+			vec2 newPosition = vec2(0, start);
 
-			i++;
-
-			elem->position = vec2(0, elem->size.y + ContentDistance) * (float)i;
+			if (elem->position != newPosition)
+			{
+				elem->position = newPosition;
+				moved = true;
+			}
 
+			start += elem->GetSize().y + ContentDistance;
 		}
 
-		UiElement::Update();
+		return moved;
 	}
 
 private:
@@ -25,6 +25,9 @@ public:
 
 		UiElement::Update();
 
+		// after the elements' updates so this frame's changes are drawn in place
+		LayoutIfNeeded();
+
 	}
 
 	vec2 GetSize()
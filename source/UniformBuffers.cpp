@@ -0,0 +1,169 @@
+#include "UniformBuffers.h"
+
+#include <cstring>
+
+#include "RenderPacket.h"
+#include "RenderState.h"
+
+GLuint UniformBuffers::frameBuffer = 0;
+GLuint UniformBuffers::objectBuffer = 0;
+
+GLsizeiptr UniformBuffers::frameStride = sizeof(UniformBuffers::FrameData);
+GLsizeiptr UniformBuffers::objectStride = sizeof(UniformBuffers::ObjectData);
+
+uint32_t UniformBuffers::objectCapacity = 0;
+uint32_t UniformBuffers::objectCursor = 0;
+
+const RenderItem* UniformBuffers::packetItems = nullptr;
+uint32_t UniformBuffers::packetCount = 0;
+const RenderItem* UniformBuffers::shadowItems = nullptr;
+uint32_t UniformBuffers::shadowCount = 0;
+uint32_t UniformBuffers::packetBase = 0;
+
+std::vector<uint8_t> UniformBuffers::packetStaging;
+
+void UniformBuffers::Init()
+{
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment <= 0)
+		alignment = 256;
+
+	frameStride = ((GLsizeiptr)sizeof(FrameData) + alignment - 1) / alignment * alignment;
+	objectStride = ((GLsizeiptr)sizeof(ObjectData) + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &frameBuffer);
+	RenderState::BindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, frameStride * FrameSlots, nullptr, GL_DYNAMIC_DRAW);
+	RenderState::BindBufferRange(GL_UNIFORM_BUFFER, FrameBinding, frameBuffer, 0, sizeof(FrameData));
+
+	glGenBuffers(1, &objectBuffer);
+
+	Resize(4096);
+}
+
+void UniformBuffers::Resize(uint32_t capacity)
+{
+	objectCapacity = capacity;
+	objectCursor = 0;
+
+	RenderState::BindBuffer(GL_UNIFORM_BUFFER, objectBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, objectStride * objectCapacity, nullptr, GL_DYNAMIC_DRAW);
+}
+
+void UniformBuffers::SetFrame(const mat4& view, const mat4& projection, const mat4& projectionViewmodel, const vec3& cameraPosition, uint32_t slot)
+{
+	FrameData data;
+	data.View = view;
+	data.Projection = projection;
+	data.ProjectionViewmodel = projectionViewmodel;
+	data.CameraPosition = vec4(cameraPosition, 1.0f);
+
+	RenderState::BindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, frameStride * slot, sizeof(FrameData), &data);
+	RenderState::BindBufferRange(GL_UNIFORM_BUFFER, FrameBinding, frameBuffer, frameStride * slot, sizeof(FrameData));
+}
+
+UniformBuffers::ObjectData UniformBuffers::MakeObjectData(const RenderItem& item)
+{
+	ObjectData data;
+	data.World = item.World;
+	data.Flags = ivec4(item.IsViewmodel ? 1 : 0, (int)item.BoneOffset, (int)item.BoneCount, 0);
+
+	return data;
+}
+
+uint32_t UniformBuffers::Allocate(uint32_t count)
+{
+	if (objectCursor + count <= objectCapacity)
+	{
+		uint32_t slot = objectCursor;
+		objectCursor += count;
+		return slot;
+	}
+
+	// orphan: draws already issued keep reading the old storage
+	RenderState::BindBuffer(GL_UNIFORM_BUFFER, objectBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, objectStride * objectCapacity, nullptr, GL_DYNAMIC_DRAW);
+	objectCursor = 0;
+
+	// the packet may still have draws to issue, move it along into the new storage
+	if (packetCount + shadowCount > 0)
+	{
+		packetBase = 0;
+		objectCursor = packetCount + shadowCount;
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, packetStaging.size(), packetStaging.data());
+	}
+
+	uint32_t slot = objectCursor;
+	objectCursor += count;
+	return slot;
+}
+
+void UniformBuffers::UploadObjects(const RenderPacket& packet)
+{
+	packetItems = nullptr;
+	packetCount = 0;
+	shadowItems = nullptr;
+	shadowCount = 0;
+
+	uint32_t itemCount = (uint32_t)packet.Items.size();
+	uint32_t count = itemCount + (uint32_t)packet.ShadowItems.size();
+	if (count == 0)
+		return;
+
+	// room for the packet plus the odd draw outside of it
+	if (count + 256 > objectCapacity)
+	{
+		uint32_t capacity = objectCapacity;
+		while (count + 256 > capacity)
+			capacity *= 2;
+
+		Resize(capacity);
+	}
+
+	packetStaging.resize(objectStride * count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const RenderItem& item = i < itemCount ? packet.Items[i] : packet.ShadowItems[i - itemCount];
+
+		ObjectData data = MakeObjectData(item);
+		memcpy(packetStaging.data() + objectStride * i, &data, sizeof(ObjectData));
+	}
+
+	packetBase = Allocate(count);
+
+	RenderState::BindBuffer(GL_UNIFORM_BUFFER, objectBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, objectStride * packetBase, packetStaging.size(), packetStaging.data());
+
+	packetItems = packet.Items.data();
+	packetCount = itemCount;
+	shadowItems = packet.ShadowItems.data();
+	shadowCount = count - itemCount;
+}
+
+void UniformBuffers::BindObject(const RenderItem& item)
+{
+	uint32_t slot;
+
+	if (packetItems != nullptr && &item >= packetItems && &item < packetItems + packetCount)
+	{
+		slot = packetBase + (uint32_t)(&item - packetItems);
+	}
+	else if (shadowItems != nullptr && &item >= shadowItems && &item < shadowItems + shadowCount)
+	{
+		slot = packetBase + packetCount + (uint32_t)(&item - shadowItems);
+	}
+	else
+	{
+		slot = Allocate(1);
+
+		ObjectData data = MakeObjectData(item);
+
+		RenderState::BindBuffer(GL_UNIFORM_BUFFER, objectBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, objectStride * slot, sizeof(ObjectData), &data);
+	}
+
+	RenderState::BindBufferRange(GL_UNIFORM_BUFFER, ObjectBinding, objectBuffer, objectStride * slot, sizeof(ObjectData));
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "gl.h"
+#include "glm.h"
+
+struct RenderItem;
+struct RenderPacket;
+
+// std140 uniform blocks shared by the mesh shaders.
+//
+// FrameData holds the camera of the current pass and is written once per pass, every pass
+// of a frame in its own slot so passes do not overwrite data earlier draws still read.
+// ObjectData holds per draw values. The objects of a whole packet are written in one
+// upload into a ring buffer and every draw only binds its range, so a draw costs one
+// glBindBufferRange instead of a glUniform call and a name lookup per value.
+//
+// Shaders declare the blocks as
+//
+//	layout(std140) uniform FrameData { mat4 view; mat4 projection; mat4 projectionViewmodel; vec4 cameraPosition; };
+//	layout(std140) uniform ObjectData { mat4 world; ivec4 objectFlags; };
+//
+// and ShaderProgram::LinkProgram binds them to the binding points below by name.
+class UniformBuffers
+{
+public:
+
+	static const GLuint FrameBinding = 0;
+	static const GLuint ObjectBinding = 1;
+
+	// slot 0 is the main camera, shadow passes use the ones after it
+	static const uint32_t FrameSlots = 4;
+
+	// layouts must match the GLSL blocks above
+	struct FrameData
+	{
+		mat4 View;
+		mat4 Projection;
+		mat4 ProjectionViewmodel;
+		vec4 CameraPosition;
+	};
+
+	struct ObjectData
+	{
+		mat4 World;
+
+		// x: viewmodel, y: first bone in the bone texture, z: bone count (0 draws unskinned)
+		ivec4 Flags;
+	};
+
+	static void Init();
+
+	// Writes the camera of the pass that is about to draw into slot and binds it.
+	static void SetFrame(const mat4& view, const mat4& projection, const mat4& projectionViewmodel, const vec3& cameraPosition, uint32_t slot = 0);
+
+	// Writes the object data of every item and shadow item in the packet, in item order.
+	static void UploadObjects(const RenderPacket& packet);
+
+	// Binds the object range of an item. Items that are not part of the uploaded
+	// packet (debug draws and such) get their data written on the spot.
+	static void BindObject(const RenderItem& item);
+
+private:
+
+	static GLuint frameBuffer;
+	static GLuint objectBuffer;
+
+	// bytes between slots, the struct size rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	static GLsizeiptr frameStride;
+	static GLsizeiptr objectStride;
+
+	// ring capacity in objects
+	static uint32_t objectCapacity;
+	static uint32_t objectCursor;
+
+	// items of the uploaded packet and the ring slot of the first one, shadow items follow the items
+	static const RenderItem* packetItems;
+	static uint32_t packetCount;
+	static const RenderItem* shadowItems;
+	static uint32_t shadowCount;
+	static uint32_t packetBase;
+
+	// object data of the uploaded packet (items and shadow items), kept to move it when the ring wraps
+	static std::vector<uint8_t> packetStaging;
+
+	static ObjectData MakeObjectData(const RenderItem& item);
+
+	static void Resize(uint32_t capacity);
+
+	// Reserves count consecutive slots. When the ring wraps the buffer is orphaned so
+	// draws already issued keep their data, and the packet is written again at the start.
+	static uint32_t Allocate(uint32_t count);
+
+};
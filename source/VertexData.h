@@ -4,9 +4,14 @@
 #include "gl.h"
 
 #include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
 
 #include "EObject.hpp"
 
+#include "RenderState.h"
+
 // Helper to calculate offsets
 #define OFFSET_OF(type, member) ((void*)offsetof(type, member))
 
@@ -44,10 +49,10 @@ public:
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(T), vertices.data(), usage);
     }
 
-    ~VertexBuffer() { glDeleteBuffers(1, &m_id); }
+    ~VertexBuffer() { RenderState::OnBufferDeleted(m_id); glDeleteBuffers(1, &m_id); }
 
-    void Bind() const { glBindBuffer(GL_ARRAY_BUFFER, m_id); }
-    static void Unbind() { glBindBuffer(GL_ARRAY_BUFFER, 0); }
+    void Bind() const { RenderState::BindBuffer(GL_ARRAY_BUFFER, m_id); }
+    static void Unbind() { RenderState::BindBuffer(GL_ARRAY_BUFFER, 0); }
 
     const VertexDeclaration& GetDeclaration() const { return m_declaration; }
     size_t GetVertexCount() const { return m_vertexCount; }
@@ -61,23 +66,43 @@ private:
 class IndexBuffer : public EObject
 {
 public:
+    // Stored as 16-bit indices when every index fits. 0xFFFF is left out, WebGL2 always
+    // treats it as the primitive restart index.
     IndexBuffer(const std::vector<GLuint>& indices, GLenum usage = GL_STATIC_DRAW)
         : m_indexCount(indices.size()) {
         glGenBuffers(1, &m_id);
         Bind();
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), usage);
+
+        GLuint maxIndex = 0;
+        for (GLuint index : indices)
+            maxIndex = std::max(maxIndex, index);
+
+        if (maxIndex < 0xFFFF) {
+            m_type = GL_UNSIGNED_SHORT;
+
+            std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), shortIndices.data(), usage);
+        }
+        else {
+            m_type = GL_UNSIGNED_INT;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), usage);
+        }
     }
 
-    ~IndexBuffer() { glDeleteBuffers(1, &m_id); }
+    ~IndexBuffer() { RenderState::OnBufferDeleted(m_id); glDeleteBuffers(1, &m_id); }
 
-    void Bind() const { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_id); }
-    static void Unbind() { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); }
+    void Bind() const { RenderState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_id); }
+    static void Unbind() { RenderState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); }
 
     size_t GetIndexCount() const { return m_indexCount; }
 
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, for glDrawElements
+    GLenum GetIndexType() const { return m_type; }
+
 private:
     GLuint m_id;
     size_t m_indexCount;
+    GLenum m_type = GL_UNSIGNED_INT;
 };
 
 class VertexArrayObject : public EObject 
@@ -85,15 +110,17 @@ class VertexArrayObject : public EObject
 public:
 
     int IndexCount = 0;
+    GLenum IndexType = GL_UNSIGNED_INT;
 
     VertexBuffer* vertexBuffer = nullptr;
     IndexBuffer* indexBuffer = nullptr;
 
     VertexArrayObject(VertexBuffer& vb, IndexBuffer& ib) {
         glGenVertexArrays(1, &m_id);
-        glBindVertexArray(m_id);
+        RenderState::BindVertexArray(m_id);
 
         IndexCount = ib.GetIndexCount();
+        IndexType = ib.GetIndexType();
 
         vertexBuffer = &vb;
         indexBuffer = &ib;
@@ -104,55 +131,86 @@ public:
 
         const auto& elements = vb.GetDeclaration().GetElements();   
         for (const auto& element : elements) {
-            glEnableVertexAttribArray(element.index);
-            // Determine attribute type category
-            const bool isIntegerType =
-                element.type == GL_INT ||
-                element.type == GL_UNSIGNED_INT ||
-                element.type == GL_BYTE ||
-                element.type == GL_UNSIGNED_BYTE ||
-                element.type == GL_SHORT ||
-                element.type == GL_UNSIGNED_SHORT;
-
-
-            if (isIntegerType && !element.normalized) {
-                // Integer attributes (non-normalized)
-                glVertexAttribIPointer(
-                    element.index,
-                    element.componentCount,
-                    element.type,
-                    element.stride,
-                    element.offset
-                );
-            }
-            else {
-                // Normalized integers and floating-point attributes
-                glVertexAttribPointer(
-                    element.index,
-                    element.componentCount,
-                    element.type,
-                    element.normalized,
-                    element.stride,
-                    element.offset
-                );
-            }
-            if (element.divisor > 0) {
-                glVertexAttribDivisor(element.index, element.divisor);
-            }
+            ApplyElement(element, 0);
         }
 
-        glBindVertexArray(0);
+        RenderState::BindVertexArray(0);
         VertexBuffer::Unbind();
         IndexBuffer::Unbind();
     }
 
-    ~VertexArrayObject() { glDeleteVertexArrays(1, &m_id); }
+    ~VertexArrayObject() { RenderState::OnVertexArrayDeleted(m_id); glDeleteVertexArrays(1, &m_id); }
+
+    void Bind() const { RenderState::BindVertexArray(m_id); }
+    static void Unbind() { RenderState::BindVertexArray(0); }
+
+    // Points the per instance attributes of declaration at the buffer bound to GL_ARRAY_BUFFER,
+    // starting baseOffset bytes in. The VAO has to be bound. GLES3 has no base instance, so
+    // this is how an instanced draw selects its range.
+    static void BindInstanceAttributes(const VertexDeclaration& declaration, GLintptr baseOffset) {
+        for (const auto& element : declaration.GetElements()) {
+            ApplyElement(element, baseOffset);
+        }
+    }
+
+    // Current values of the skinning attributes for vertex layouts without them: no bones,
+    // zero weights. Integer typed, as WebGL2 checks them against the shader's uvec4.
+    static void InitDefaultAttributes() {
+        glVertexAttribI4ui(5, 0, 0, 0, 0);
+        glVertexAttrib4f(6, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
 
-    void Bind() const { glBindVertexArray(m_id); }
-    static void Unbind() { glBindVertexArray(0); }
+    // Disables the attributes again so plain draws of the VAO don't read the instance buffer.
+    static void UnbindInstanceAttributes(const VertexDeclaration& declaration) {
+        for (const auto& element : declaration.GetElements()) {
+            glDisableVertexAttribArray(element.index);
+            glVertexAttribDivisor(element.index, 0);
+        }
+    }
 
 private:
     GLuint m_id;
+
+    static void ApplyElement(const VertexDeclaration::Element& element, GLintptr baseOffset) {
+        glEnableVertexAttribArray(element.index);
+
+        const void* offset = (const char*)element.offset + baseOffset;
+
+        // Determine attribute type category
+        const bool isIntegerType =
+            element.type == GL_INT ||
+            element.type == GL_UNSIGNED_INT ||
+            element.type == GL_BYTE ||
+            element.type == GL_UNSIGNED_BYTE ||
+            element.type == GL_SHORT ||
+            element.type == GL_UNSIGNED_SHORT;
+
+
+        if (isIntegerType && !element.normalized) {
+            // Integer attributes (non-normalized)
+            glVertexAttribIPointer(
+                element.index,
+                element.componentCount,
+                element.type,
+                element.stride,
+                offset
+            );
+        }
+        else {
+            // Normalized integers and floating-point attributes
+            glVertexAttribPointer(
+                element.index,
+                element.componentCount,
+                element.type,
+                element.normalized,
+                element.stride,
+                offset
+            );
+        }
+        if (element.divisor > 0) {
+            glVertexAttribDivisor(element.index, element.divisor);
+        }
+    }
 };
 
 // Example usage with your VertexData structure
@@ -180,4 +238,145 @@ struct VertexData {
             {8, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), OFFSET_OF(VertexData, Color), 0}
             });
     }
-};
\ No newline at end of file
+};
+
+// GPU vertex layouts. Meshes keep VertexData on the CPU (physics, navigation, bounds) and
+// upload one of these packed forms:
+//  normals and tangents as snorm 10-10-10-2, the tangent's w holding the bitangent sign,
+//  texture coordinates as two halfs, color as unorm bytes,
+//  and for skinned meshes bone ids as bytes with unorm byte weights.
+// StaticVertex is 28 bytes and SkinnedVertex 36, against 116 for VertexData.
+namespace VertexPacking {
+
+    inline uint32_t PackDirection(glm::vec3 direction, float w = 0.0f) {
+        float length = glm::length(direction);
+        if (length > 0.0f)
+            direction /= length;
+
+        return glm::packSnorm3x10_1x2(glm::vec4(direction, w));
+    }
+
+    inline uint32_t PackTangent(const VertexData& vertex) {
+        float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.BiTangent) < 0.0f ? -1.0f : 1.0f;
+        return PackDirection(vertex.Tangent, handedness);
+    }
+
+    // Rounds the weights to bytes that still add up to 255.
+    inline void PackWeights(const glm::vec4& weights, uint8_t output[4]) {
+        float sum = weights.x + weights.y + weights.z + weights.w;
+        if (sum <= 0.0f) {
+            output[0] = output[1] = output[2] = output[3] = 0;
+            return;
+        }
+
+        int total = 0;
+        int largest = 0;
+        for (int i = 0; i < 4; i++) {
+            output[i] = (uint8_t)std::lround(weights[i] / sum * 255.0f);
+            total += output[i];
+            if (weights[i] > weights[largest])
+                largest = i;
+        }
+
+        output[largest] = (uint8_t)std::clamp(output[largest] + 255 - total, 0, 255);
+    }
+}
+
+struct StaticVertex {
+    glm::vec3 Position = vec3();
+    uint32_t Normal = 0;
+    uint32_t Tangent = 0;
+    uint32_t TextureCoordinate = 0;
+    uint32_t Color = 0xFFFFFFFF;
+
+    static StaticVertex FromVertexData(const VertexData& vertex) {
+        StaticVertex result;
+        result.Position = vertex.Position;
+        result.Normal = VertexPacking::PackDirection(vertex.Normal);
+        result.Tangent = VertexPacking::PackTangent(vertex);
+        result.TextureCoordinate = glm::packHalf2x16(vertex.TextureCoordinate);
+        result.Color = glm::packUnorm4x8(vertex.Color);
+        return result;
+    }
+
+    static VertexDeclaration Declaration() {
+        return VertexDeclaration({
+            {0, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), OFFSET_OF(StaticVertex, Position), 0},
+            {1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(StaticVertex), OFFSET_OF(StaticVertex, Normal), 0},
+            {2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(StaticVertex), OFFSET_OF(StaticVertex, TextureCoordinate), 0},
+            {3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(StaticVertex), OFFSET_OF(StaticVertex, Tangent), 0},
+            {8, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(StaticVertex), OFFSET_OF(StaticVertex, Color), 0}
+            });
+    }
+};
+
+struct SkinnedVertex {
+    glm::vec3 Position = vec3();
+    uint32_t Normal = 0;
+    uint32_t Tangent = 0;
+    uint32_t TextureCoordinate = 0;
+    uint32_t Color = 0xFFFFFFFF;
+    uint8_t BlendIndices[4] = { 0,0,0,0 };
+    uint8_t BlendWeights[4] = { 0,0,0,0 };
+
+    static SkinnedVertex FromVertexData(const VertexData& vertex) {
+        SkinnedVertex result;
+        result.Position = vertex.Position;
+        result.Normal = VertexPacking::PackDirection(vertex.Normal);
+        result.Tangent = VertexPacking::PackTangent(vertex);
+        result.TextureCoordinate = glm::packHalf2x16(vertex.TextureCoordinate);
+        result.Color = glm::packUnorm4x8(vertex.Color);
+
+        for (int i = 0; i < 4; i++)
+            result.BlendIndices[i] = (uint8_t)std::clamp(vertex.BlendIndices[i], 0, 255);
+
+        VertexPacking::PackWeights(vertex.BlendWeights, result.BlendWeights);
+        return result;
+    }
+
+    static VertexDeclaration Declaration() {
+        return VertexDeclaration({
+            {0, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), OFFSET_OF(SkinnedVertex, Position), 0},
+            {1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(SkinnedVertex), OFFSET_OF(SkinnedVertex, Normal), 0},
+            {2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(SkinnedVertex), OFFSET_OF(SkinnedVertex, TextureCoordinate), 0},
+            {3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(SkinnedVertex), OFFSET_OF(SkinnedVertex, Tangent), 0},
+            {5, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(SkinnedVertex), OFFSET_OF(SkinnedVertex, BlendIndices), 0},
+            {6, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SkinnedVertex), OFFSET_OF(SkinnedVertex, BlendWeights), 0},
+            {8, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SkinnedVertex), OFFSET_OF(SkinnedVertex, Color), 0}
+            });
+    }
+};
+
+// Uploads vertices in the layout for the mesh kind. Skinned layouts hold bone ids below 256.
+inline VertexBuffer* CreatePackedVertexBuffer(const std::vector<VertexData>& vertices, bool skinned, GLenum usage = GL_STATIC_DRAW) {
+    if (skinned) {
+        std::vector<SkinnedVertex> packed;
+        packed.reserve(vertices.size());
+        for (const VertexData& vertex : vertices)
+            packed.push_back(SkinnedVertex::FromVertexData(vertex));
+
+        return new VertexBuffer(packed, SkinnedVertex::Declaration(), usage);
+    }
+
+    std::vector<StaticVertex> packed;
+    packed.reserve(vertices.size());
+    for (const VertexData& vertex : vertices)
+        packed.push_back(StaticVertex::FromVertexData(vertex));
+
+    return new VertexBuffer(packed, StaticVertex::Declaration(), usage);
+}
+
+// Per instance data of instanced draws, read by skeletal_instanced.vert.
+// A mat4 attribute takes 4 locations, one per column.
+struct InstanceData {
+    glm::mat4 World = mat4(1.0f);
+
+    static VertexDeclaration Declaration() {
+        return VertexDeclaration({
+            {9, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, World) + sizeof(glm::vec4) * 0), 1},
+            {10, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, World) + sizeof(glm::vec4) * 1), 1},
+            {11, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, World) + sizeof(glm::vec4) * 2), 1},
+            {12, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, World) + sizeof(glm::vec4) * 3), 1}
+            });
+    }
+};
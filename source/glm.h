@@ -13,6 +13,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
 
 #else
 #include "glm/glm.hpp"
@@ -24,6 +25,7 @@
 #include "glm/gtc/type_ptr.hpp"
 #include "glm/gtx/quaternion.hpp"
 #include "glm/gtx/hash.hpp"
+#include "glm/gtc/packing.hpp"
 #endif
 
 using namespace glm;
\ No newline at end of file
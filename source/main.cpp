@@ -426,6 +426,8 @@ int main(int argc, char* args[])
 
 
     // Clean up
+    engine->Shutdown();
+
     SDL_GL_DeleteContext(glContext);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -8,6 +8,8 @@ namespace roj
 
     std::string LoaderGlobalParams::MeshNameLimit;
     float LoaderGlobalParams::Size = 1;
+    bool LoaderGlobalParams::GenerateLods = true;
+    bool LoaderGlobalParams::OptimizeMeshes = true;
 
 template<>
 std::vector<VertexData> ModelLoader<Mesh>::getMeshVertices(aiMesh* mesh)
@@ -50,7 +52,7 @@ Mesh ModelLoader<Mesh>::processMesh(aiMesh* mesh, const aiScene* scene)
 
     Mesh m;
 
-    m.vertexBuffer = new VertexBuffer(vertices, VertexData::Declaration());
+    m.vertexBuffer = CreatePackedVertexBuffer(vertices, false);
 
     return m;
 }
@@ -14,6 +14,7 @@
 #include <string>
 
 #include "VertexData.h"
+#include "MeshOptimizer.h"
 
 namespace roj
 {
@@ -25,6 +26,12 @@ namespace roj
 		static std::string MeshNameLimit;
 		static float Size;
 
+		// build simplified LODs of dense meshes while loading
+		static bool GenerateLods;
+
+		// weld vertices and reorder index and vertex buffers for the GPU caches while loading
+		static bool OptimizeMeshes;
+
 	private:
 
 	};
@@ -73,6 +80,10 @@ namespace roj
 		std::unordered_map<glm::vec3, glm::vec3> vertexNormals; // position and normal
 		std::unordered_map<glm::vec3, float> vertexNormalsN; // position and normal num
 
+		// vertex cache statistics of the loaded meshes before and after MeshOptimizer
+		MeshOptimizer::CacheStats m_sourceCacheStats;
+		MeshOptimizer::CacheStats m_optimizedCacheStats;
+
 	private:
 
 		
@@ -164,6 +175,9 @@ namespace roj
 		vertexNormals.clear();
 		vertexNormalsN.clear();
 
+		m_sourceCacheStats = {};
+		m_optimizedCacheStats = {};
+
 	}
 }
 
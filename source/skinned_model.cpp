@@ -1,4 +1,6 @@
 #include "skinned_model.hpp"
+#include <cfloat>
+#include <cstdio>
 #include <filesystem>
 
 #include "gl.h"
@@ -6,9 +8,60 @@
 #include "utils.hpp"
 
 #include "Logger.hpp"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 
 using namespace utils::assimp;
 
+// levels after the full mesh, and the smallest mesh worth simplifying
+static const int MaxGeneratedLods = 3;
+static const size_t MinLodTriangles = 256;
+
+// Halves the triangle count level by level until the mesh gets small or stops shrinking.
+static void generateLods(roj::SkinnedModel& model)
+{
+	for (roj::SkinnedMesh& mesh : model.meshes)
+	{
+		std::vector<vec3> positions;
+		positions.reserve(mesh.vertexLocations.size());
+
+		for (const VertexData& vertex : mesh.vertexLocations)
+			positions.push_back(vertex.Position);
+
+		std::vector<uint32_t> current = mesh.vertexIndices;
+
+		for (int lod = 0; lod < MaxGeneratedLods; lod++)
+		{
+			if (current.size() / 3 < MinLodTriangles)
+				break;
+
+			float error = 0;
+			std::vector<uint32_t> simplified = MeshSimplifier::Simplify(positions, current, current.size() / 6 * 3, FLT_MAX, &error);
+
+			// locked borders and seams left too little to remove
+			if (simplified.empty() || simplified.size() > current.size() * 9 / 10)
+				break;
+
+			if (roj::LoaderGlobalParams::OptimizeMeshes)
+			{
+				MeshOptimizer::OptimizeVertexCache(simplified, mesh.vertexLocations.size());
+				MeshOptimizer::OptimizeOverdraw(simplified, mesh.vertexLocations);
+			}
+
+			roj::MeshLod meshLod;
+			meshLod.indices = new IndexBuffer(simplified);
+			meshLod.VAO = new VertexArrayObject(*mesh.vertices, *meshLod.indices);
+			meshLod.error = error;
+
+			mesh.lods.push_back(meshLod);
+
+			current = std::move(simplified);
+		}
+
+		model.lodCount = std::max(model.lodCount, (int)mesh.lods.size() + 1);
+	}
+}
+
 static void extractBoneData(std::vector<VertexData>& vertices, aiMesh* mesh, roj::SkinnedModel& model)
 {
 	for (unsigned int i = 0; i < mesh->mNumBones; ++i)
@@ -175,11 +228,24 @@ namespace roj
 		}
 		extractBoneData(vertices, mesh, m_model);
 
+		// after the bone data, the weights are looked up by assimp's vertex ids
+		if (LoaderGlobalParams::OptimizeMeshes)
+		{
+			m_sourceCacheStats.Add(MeshOptimizer::AnalyzeVertexCache(indices, vertices.size()));
+
+			MeshOptimizer::Optimize(vertices, indices);
+
+			m_optimizedCacheStats.Add(MeshOptimizer::AnalyzeVertexCache(indices, vertices.size()));
+		}
+
 		SkinnedMesh skinMesh = SkinnedMesh();
 
 		skinMesh.name = mesh->mName.C_Str();
 
-		skinMesh.vertices = new VertexBuffer(vertices, VertexData::Declaration());
+		// meshes without bones get the smaller static layout
+		bool skinned = mesh->mNumBones > 0;
+
+		skinMesh.vertices = CreatePackedVertexBuffer(vertices, skinned);
 
 		skinMesh.indices = new IndexBuffer(indices);
 
@@ -290,11 +356,28 @@ namespace roj
 
 		processNode(scene->mRootNode, scene);
 
+		// SkinnedVertex stores bone ids as bytes
+		if (m_model.boneCount > 256)
+			Logger::Log(path + " has " + std::to_string(m_model.boneCount) + " bones, only the first 256 can be skinned");
+
 		for (SkinnedMesh& mesh : m_model)
 		{
 			mesh.VAO = new VertexArrayObject(*mesh.vertices, *mesh.indices);
 		}
 
+		if (LoaderGlobalParams::GenerateLods)
+			generateLods(m_model);
+
+		if (m_sourceCacheStats.Triangles > 0)
+		{
+			char stats[96];
+			snprintf(stats, sizeof(stats), "ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+				m_sourceCacheStats.GetACMR(), m_optimizedCacheStats.GetACMR(),
+				m_sourceCacheStats.GetATVR(), m_optimizedCacheStats.GetATVR());
+
+			Logger::Log(path + " " + stats);
+		}
+
 
 
 		extractAnimations(scene, m_model);
@@ -1,6 +1,7 @@
 #ifndef SKINNED_MODEL_HPP
 #define SKINNED_MODEL_HPP
 #include "model.hpp"
+#include <algorithm>
 #include <unordered_map>
 
 #include <vector>
@@ -14,6 +15,17 @@
 namespace roj
 {
 	
+	// Coarser version of a mesh: its own indices over the mesh's vertex buffer.
+	struct MeshLod
+	{
+		IndexBuffer* indices = nullptr;
+		VertexArrayObject* VAO = nullptr;
+
+		// largest collapse error of the simplification, an area weighted RMS distance in model
+		// units (see MeshSimplifier::Simplify)
+		float error = 0;
+	};
+
 	struct SkinnedMesh
 	{
 
@@ -31,6 +43,18 @@ namespace roj
 
 		Texture* cachedBaseColor = nullptr;
 
+		// LOD 1 and up, each about half the triangles of the one before
+		std::vector<MeshLod> lods;
+
+		// The VAO to draw at a model LOD. Meshes with fewer levels use their coarsest one.
+		VertexArrayObject* GetVAO(int lod) const
+		{
+			if (lod <= 0 || lods.empty())
+				return VAO;
+
+			return lods[std::min(lod, (int)lods.size()) - 1].VAO;
+		}
+
 	};
 
 
@@ -76,6 +100,9 @@ namespace roj
 
 		BoudingSphere boundingSphere;
 
+		// levels of the most detailed LOD chain of the meshes, 1 without LODs
+		int lodCount{ 1 };
+
 		std::vector<SkinnedMesh>::iterator begin();
 		std::vector<SkinnedMesh>::iterator end();
 		void clear();